@@ -20,7 +20,7 @@ int main()
   struct s_environment environment;
 
   //init environment for engine
-  initEnv(&environment, 1);
+  initEnv(&environment, 1, 0, DOUBLE_BUF);
   
   //needed for sound
   setupSound(&environment);
@@ -38,11 +38,15 @@ int main()
   
   playCDtracks(tracks, 0);
 
+  //move the selected primitive every tick
+  addJob(&environment, movPrim, 1);
+
   //display and move primitive forever
   for(;;)
   {
     display(&environment);
-    movPrim(&environment);
+    runJobs(&environment);
+    updatePrim(&environment);
   }
 
   //no cleanup, we never quit
@@ -53,21 +57,11 @@ int main()
 void createGameObjects(struct s_environment *p_env)
 {
   int index;
-  int buffIndex;
   
-  //otSize is the same as the number of primitives
-  for(index = 0; index < p_env->otSize; index++)
+  //one object per primitive slot
+  for(index = 0; index < p_env->primSize; index++)
   {
     //all of them will be based on this type
     p_env->p_primParam[index] = getObjects("\\TEXTURE.XML;1");
- 
-    if(p_env->p_primParam[index] != NULL)
-    {
-      //allocate for each buffer its primitive type
-      for(buffIndex = 0; buffIndex < DOUBLE_BUF; buffIndex++)
-      {
-	p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(POLY_FT4));
-      }
-    }
   } 
 }
\ No newline at end of file
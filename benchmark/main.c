@@ -0,0 +1,300 @@
+/*
+ * Benchmark, mixed primitives made in code (nothing read from CD) that move and spin every tick.
+ * 
+ * Build the engine and this with PSX_DEFINES=-DENGINE_PROFILE to see frame times on screen.
+ * Circle switches between squares sharing a few rotations and every square turning on its own.
+ * Square switches the per type batches off, every primitive then loads its whole matrix in index order.
+ * Triangle switches the inline gte path and the library calls, cycles per primitive are shown by profile builds.
+ * Select times every actor asking for the actors overlapping it, through the spatial grid and by testing every
+ * pair, at 100, 500 and 1000 actors. Times are in screen lines.
+ * 
+ */
+
+#include <engine.h>
+#include <libapi.h>
+
+//number of objects, and how many blocks of objects share one rotation
+#define OBJECTS 1000
+#define GROUPS  4
+//actor counts the query benchmark runs at
+#define QUERY_RUNS 3
+
+//velocity of every object
+struct s_svertex g_velocity[OBJECTS];
+//types handed out in turn
+enum en_primType const gc_benchTypes[] = {TYPE_F4, TYPE_G4, TYPE_TILE};
+//every object turns on its own when set
+int g_ownRotation = 0;
+//actor counts of the query benchmark, lines each way took and pairs each way found
+int const gc_queryActors[QUERY_RUNS] = {100, 500, 1000};
+long g_gridLines[QUERY_RUNS];
+long g_bruteLines[QUERY_RUNS];
+int g_gridPairs[QUERY_RUNS];
+int g_brutePairs[QUERY_RUNS];
+
+//create game objects
+void createGameObjects(struct s_environment *p_env);
+//move objects, bounce off the screen edges
+void movObjects(struct s_environment *p_env);
+//spin squares, by group or each on its own
+void spinObjects(struct s_environment *p_env);
+//time overlap queries through the grid and by brute force
+void runQueries(struct s_environment *p_env);
+
+int main() 
+{
+  int index;
+  int prevTime = 0;
+  int prevBatchTime = 0;
+  int prevGteTime = 0;
+  int prevQueryTime = 0;
+  
+  char *p_title = "Benchmark\nMixed Primitives";
+  struct s_environment environment;
+  
+  initEnv(&environment, OBJECTS, 0, DOUBLE_BUF);
+  
+  environment.envMessage.p_title = p_title;
+  environment.envMessage.p_message = NULL;
+  environment.envMessage.p_data = (int *)&environment.gamePad.one;
+  
+  createGameObjects(&environment);
+  
+  populateOT(&environment);
+  
+  reportArena(&environment);
+  
+  //screen lines for the query benchmark
+  SetRCnt(RCntCNT1, 0xFFFF, RCntMdNOINTR);
+  StartRCnt(RCntCNT1);
+  
+  addJob(&environment, movObjects, 1);
+  addJob(&environment, spinObjects, 1);
+
+  for(;;)
+  {
+    display(&environment);
+    
+    FntPrint("\nOBJECTS %d DRAWN %d\nROT LOADS %d %s\n2D %d", OBJECTS, environment.primStats.drawn, environment.primStats.rotLoads, (g_ownRotation ? "OWN" : "SHARED"), environment.primStats.flat);
+    FntPrint("\nROT CACHE HIT %d MISS %d", environment.rotCache.lastHits, environment.rotCache.lastMisses);
+    FntPrint("\nBATCHES %s GTE %s", (environment.noBatches ? "OFF" : "ON"), (environment.useGteLibrary ? "LIBRARY" : "INLINE"));
+    
+    for(index = 0; index < QUERY_RUNS; index++)
+    {
+      FntPrint("\n%d GRID %d BRUTE %d PAIRS %d %d", gc_queryActors[index], g_gridLines[index], g_bruteLines[index], g_gridPairs[index], g_brutePairs[index]);
+    }
+    
+    //circle switches rotation sharing
+    if(environment.gamePad.one.fourth.bit.circle == 0)
+    {
+      if(checkRate(&environment, &prevTime, 60))
+      {
+	g_ownRotation = !g_ownRotation;
+      }
+    }
+    
+    //square switches batching
+    if(environment.gamePad.one.fourth.bit.square == 0)
+    {
+      if(checkRate(&environment, &prevBatchTime, 60))
+      {
+	environment.noBatches = !environment.noBatches;
+      }
+    }
+    
+    //triangle switches the gte path
+    if(environment.gamePad.one.fourth.bit.triangle == 0)
+    {
+      if(checkRate(&environment, &prevGteTime, 60))
+      {
+	environment.useGteLibrary = !environment.useGteLibrary;
+      }
+    }
+    
+    //select runs the query benchmark, frames stall while it runs
+    if(environment.gamePad.one.third.bit.select == 0)
+    {
+      if(checkRate(&environment, &prevQueryTime, 60))
+      {
+	runQueries(&environment);
+      }
+    }
+    
+    PROF_BEGIN(PROF_USER);
+    runJobs(&environment);
+    PROF_END(PROF_USER);
+    
+    //translate all primitives after updating vectors
+    for(index = 0; index < environment.primSize; index++)
+    {
+      if(environment.p_primParam[index] != NULL)
+      {
+	transPrim(environment.p_primParam[index], &environment);
+      }
+    }
+    
+    updatePrim(&environment);
+  }
+
+  return 0;
+}
+
+//create game objects, random size, place, color and velocity
+void createGameObjects(struct s_environment *p_env)
+{
+  int index;
+  struct s_primParam *p_primParam;
+  
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    p_primParam = calloc(1, sizeof(struct s_primParam));
+    
+    if(p_primParam == NULL)
+    {
+      printf("\nOUT OF MEMORY AT OBJECT %d\n", index);
+      return;
+    }
+    
+    p_primParam->type = gc_benchTypes[index % (sizeof(gc_benchTypes) / sizeof(*gc_benchTypes))];
+    
+    p_primParam->dimensions.w = 8 + rand() % 9;
+    p_primParam->dimensions.h = 8 + rand() % 9;
+    
+    //transCoor stays the top left corner, vertex0 at minus half the size makes them spin about their center like getPrimBox expects
+    p_primParam->vertex0.vx = -(p_primParam->dimensions.w/2);
+    p_primParam->vertex0.vy = -(p_primParam->dimensions.h/2);
+    
+    p_primParam->transCoor.vx = rand() % (SCREEN_WIDTH - p_primParam->dimensions.w);
+    p_primParam->transCoor.vy = rand() % (SCREEN_HEIGHT - p_primParam->dimensions.h);
+    
+    p_primParam->color0.r = rand() % 256;
+    p_primParam->color0.g = rand() % 256;
+    p_primParam->color0.b = rand() % 256;
+    p_primParam->color1.r = rand() % 256;
+    p_primParam->color1.g = rand() % 256;
+    p_primParam->color1.b = rand() % 256;
+    p_primParam->color2.r = rand() % 256;
+    p_primParam->color2.g = rand() % 256;
+    p_primParam->color2.b = rand() % 256;
+    p_primParam->color3.r = rand() % 256;
+    p_primParam->color3.g = rand() % 256;
+    p_primParam->color3.b = rand() % 256;
+    
+    //never standing still
+    g_velocity[index].vx = (rand() % 2 ? 1 : -1) * (1 + rand() % 2);
+    g_velocity[index].vy = (rand() % 2 ? 1 : -1) * (1 + rand() % 2);
+    
+    p_env->p_primParam[index] = p_primParam;
+  }
+}
+
+//move objects, bounce off the screen edges
+void movObjects(struct s_environment *p_env)
+{
+  int index;
+  struct s_primParam *p_primParam;
+  
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    p_primParam = p_env->p_primParam[index];
+    
+    if(p_primParam == NULL)
+    {
+      continue;
+    }
+    
+    p_primParam->transCoor.vx += g_velocity[index].vx;
+    p_primParam->transCoor.vy += g_velocity[index].vy;
+    
+    if(((p_primParam->transCoor.vx <= 0) && (g_velocity[index].vx < 0)) || (((p_primParam->transCoor.vx + p_primParam->dimensions.w) >= SCREEN_WIDTH) && (g_velocity[index].vx > 0)))
+    {
+      g_velocity[index].vx = -g_velocity[index].vx;
+    }
+    
+    if(((p_primParam->transCoor.vy <= 0) && (g_velocity[index].vy < 0)) || (((p_primParam->transCoor.vy + p_primParam->dimensions.h) >= SCREEN_HEIGHT) && (g_velocity[index].vy > 0)))
+    {
+      g_velocity[index].vy = -g_velocity[index].vy;
+    }
+  }
+}
+
+//spin squares, a block of objects shares one rotation so the engine loads it once, or each turns on its own.
+//tiles can not rotate.
+void spinObjects(struct s_environment *p_env)
+{
+  int index;
+  int group;
+  
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    if((p_env->p_primParam[index] == NULL) || (p_env->p_primParam[index]->type == TYPE_TILE))
+    {
+      continue;
+    }
+    
+    group = index / (OBJECTS / GROUPS);
+    
+    p_env->p_primParam[index]->rotCoor.vz = p_env->sched.tick * 16 * (group + 1) + (g_ownRotation ? index * 8 : 0);
+  }
+}
+
+//every actor asks which others overlap it. the grid only holds the actors of the run, transPrim puts the rest
+//back next frame. brute force tests every pair on boxes worked out before the clock starts.
+void runQueries(struct s_environment *p_env)
+{
+  int run;
+  int actors;
+  int index;
+  int other;
+  int found;
+  uint16_t start;
+  static int candidates[OBJECTS];
+  static long boxes[OBJECTS][4];
+  
+  for(run = 0; run < QUERY_RUNS; run++)
+  {
+    actors = gc_queryActors[run];
+    
+    for(index = 0; index < p_env->primSize; index++)
+    {
+      if(index < actors)
+      {
+	placeGrid(p_env, p_env->p_primParam[index]);
+	getPrimBox(p_env->p_primParam[index], boxes[index]);
+      }
+      else
+      {
+	leaveGrid(p_env, p_env->p_primParam[index]);
+      }
+    }
+    
+    g_gridPairs[run] = 0;
+    start = GetRCnt(RCntCNT1);
+    
+    for(index = 0; index < actors; index++)
+    {
+      //the actor finds itself too
+      found = queryBox(p_env, boxes[index][0], boxes[index][1], boxes[index][2], boxes[index][3], candidates, OBJECTS);
+      g_gridPairs[run] += found - 1;
+    }
+    
+    g_gridLines[run] = (uint16_t)(GetRCnt(RCntCNT1) - start);
+    
+    g_brutePairs[run] = 0;
+    start = GetRCnt(RCntCNT1);
+    
+    for(index = 0; index < actors; index++)
+    {
+      for(other = 0; other < actors; other++)
+      {
+	if((other != index) && (boxes[other][0] <= boxes[index][2]) && (boxes[other][2] >= boxes[index][0]) &&
+	   (boxes[other][1] <= boxes[index][3]) && (boxes[other][3] >= boxes[index][1]))
+	{
+	  g_brutePairs[run]++;
+	}
+      }
+    }
+    
+    g_bruteLines[run] = (uint16_t)(GetRCnt(RCntCNT1) - start);
+  }
+}
@@ -11,13 +11,82 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <libgte.h>
 #include <libgpu.h>
 #include <libspu.h>
 
 #define DOUBLE_BUF 2
+#define TRIPLE_BUF 3
+//most buffers initEnv can setup
+#define MAX_BUF    TRIPLE_BUF
 
-enum en_primType {TYPE_F4, TYPE_FT4, TYPE_G4, TYPE_GT4, TYPE_SPRITE, TYPE_TILE};
+//dirty flags for s_primParam, kept per buffer so a change reaches every buffer's packet
+#define DIRTY_TRANS 0x01
+#define DIRTY_COLOR 0x02
+#define DIRTY_UV    0x04
+#define DIRTY_ALL   (DIRTY_TRANS | DIRTY_COLOR | DIRTY_UV)
+
+//scheduler, jobs run on logical ticks at TICK_RATE per second on NTSC and PAL alike
+#define TICK_RATE   60
+#define MAX_JOBS    8
+//most ticks a slow frame catches up on, older ticks are dropped so a stall does not snowball
+#define MAX_CATCHUP 4
+
+//rotation matrix cache entries, a power of two
+#define ROT_CACHE_SIZE 32
+//angles wrap at 4096 (one turn), keys are taken modulo a turn so equal rotations share an entry
+#define ROT_ANGLE_MASK 0xFFF
+
+//spatial grid, cells are 1 << GRID_CELL_SHIFT pixels square and tile the world 16 by 16 into the buckets
+#define GRID_CELL_SHIFT 5
+#define GRID_BUCKET_SHIFT 4
+#define GRID_BUCKETS (1 << (GRID_BUCKET_SHIFT * 2))
+
+//tilemap index of a cell without a tile
+#define TILE_EMPTY 0xFF
+
+//primitive flags
+#define PRIM_FLAG_BACKGROUND 0x01 //always placed in the deepest ordering table slot
+#define PRIM_FLAG_CULLED     0x02 //out of view, set by the engine
+#define PRIM_FLAG_FORCE_2D   0x04 //always take the 2D path, rotation, scale and depth are ignored
+#define PRIM_FLAG_2D         0x08 //positioned without the gte by the last transPrim, set by the engine
+#define PRIM_FLAG_STATIC     0x10 //member of a static group, left out of updatePrim, set by the engine
+#define PRIM_FLAG_LAYER      0x20 //composed into the background layer, left out of updatePrim, set by the engine
+#define PRIM_FLAG_LINK       0x40 //written this frame and waiting to be linked in index order, set by the engine
+#define PRIM_FLAG_TEXTURE    0x80 //holds a texture reference from populateTextures, given back by freeObjects, set by the engine
+
+//static groups, packets linked into a chain once and spliced into the table whole every frame
+#define MAX_STATIC_GROUPS 4
+
+//parsed objects getObjects keeps as templates, keyed by file name
+#define OBJECT_CACHE_SIZE 16
+
+//textures resident in vram, keyed by file name
+#define TEXTURE_CACHE_SIZE 16
+
+//binary scene files, "PRIM" read as a little endian word
+#define PRIM_BIN_MAGIC   0x4D495250
+#define PRIM_BIN_VERSION 1
+//s_primBinRecord flags
+#define PRIM_BIN_TEXTURE 0x01
+
+//TYPE_COUNT is the number of types, not a type
+enum en_primType {TYPE_F4, TYPE_FT4, TYPE_G4, TYPE_GT4, TYPE_SPRITE, TYPE_TILE, TYPE_COUNT};
+
+//how primitives are placed in the ordering table, by gte depth or by world y for 2.5D scenes
+enum en_sortMode {SORT_DEPTH, SORT_Y};
+
+//how display hands frames to the gpu, wait for draw and vsync every frame or kick the draw and keep going
+enum en_frameMode {FRAME_SYNC, FRAME_PIPELINED};
+
+//how the camera (screenCoor) is applied, subtracted from every primitive by transPrim or once a frame as a
+//draw offset packet at the head of the table. offset mode is for flat 2D worlds, the gte projects about the
+//world origin and the gpu offset range is -1024 to 1023.
+enum en_cameraMode {CAMERA_TRANSFORM, CAMERA_OFFSET};
+
+//where a buffer is in the pipelined display, changed by the draw and vsync callbacks
+enum en_bufState {BUF_FREE, BUF_DRAWING, BUF_READY, BUF_SHOWN};
 
 struct s_gamePad
 {
@@ -84,15 +153,40 @@ struct s_xmlData
 struct s_primitive
 {
   void *data;
+  void *p_tpage;
   enum en_primType type;
 };
 
-struct s_buffer
+//packet layout of a primitive type, offsets are bytes into the packet, NO_FIELD when the type lacks one.
+//new types only need an entry in the engine's table.
+#define NO_FIELD -1
+
+struct s_primTraits
 {
-  struct s_primitive *p_primitive;
-  unsigned long *p_ot;
-  DISPENV disp;
-  DRAWENV draw;
+  uint32_t size;
+  //set the packet length and gpu code
+  void (*p_init)(void *p_data);
+  //1 projects vertex0 only and uses wh for the size, 4 projects vertex0 to vertex3
+  int numVertex;
+  int16_t xy[4];
+  int16_t wh;
+  int numColor;
+  int16_t rgb[4];
+  //1 is u0 v0 only, 4 spans the texture over the corners
+  int numUV;
+  int16_t uv[4];
+  int16_t tpage;
+  //texture page needs its own DR_TPAGE packet linked in front (sprites)
+  uint8_t tpagePacket;
+};
+
+//one block of memory all gpu packets are carved from, used is reset on teardown
+struct s_primArena
+{
+  uint8_t *p_data;
+  uint32_t size;
+  uint32_t used;
+  uint32_t highWater;
 };
 
 struct s_svertex
@@ -111,6 +205,27 @@ struct s_lvertex
   int32_t pad;
 };
 
+struct s_buffer
+{
+  struct s_primitive *p_primitive;
+  unsigned long *p_ot;
+  DISPENV disp;
+  DRAWENV draw;
+  //pipelined display only, frameNum orders buffers that are ready to be shown
+  volatile enum en_bufState state;
+  uint32_t frameNum;
+  //camera offset mode, shift at the head of the table and restore at its tail
+  DR_OFFSET offset[2];
+  //copy of the background layer in view, first thing drawn
+  DR_MOVE move;
+  //dirty rect mode, full once the buffer holds a whole frame drawn with the camera at screenCoor.
+  //partial frames only redraw dirtyRect (screen coordinates).
+  uint8_t full;
+  uint8_t partial;
+  RECT dirtyRect;
+  struct s_lvertex screenCoor;
+};
+
 struct s_matrix
 {
   int16_t m[3][3];
@@ -130,12 +245,6 @@ struct s_color
   uint8_t b;
 };
 
-struct s_tpage
-{
-  unsigned long *tag;
-  unsigned long code[2];
-};
-
 struct s_texture
 {
   unsigned short id;
@@ -146,7 +255,6 @@ struct s_texture
   struct s_svertex vertex0;
   struct s_svertex vramVertex;
   struct s_dimensions dimensions;
-  struct s_tpage tpage;
   
   uint8_t *p_data;
 };
@@ -161,6 +269,9 @@ struct s_primParam
   
   struct s_lvertex realCoor;
   
+  struct s_svertex prevRotCoor;
+  struct s_lvertex prevScaleCoor;
+  
   struct s_matrix matrix;
   
   struct s_svertex vertex0;
@@ -176,6 +287,118 @@ struct s_primParam
   struct s_dimensions dimensions;
   
   struct s_texture *p_texture;
+  
+  int32_t otz;
+  
+  uint8_t flags;
+  uint8_t dirty[MAX_BUF];
+  
+  //dirty rect mode, screen box the primitive covers in each buffer
+  RECT drawnRect[MAX_BUF];
+  
+  //index in p_primParam, set by populateOT
+  int id;
+};
+
+//binary scene (libgetprim/primc), header then count records then the string table, all little endian like the psx
+struct s_primBinHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint16_t recordSize;
+  uint16_t pad;
+  uint32_t stringSize;
+};
+
+//one s_primParam, fixed width so it reads in place, fileOffset is into the string table
+struct s_primBinRecord
+{
+  uint8_t type;
+  uint8_t flags;
+  uint16_t fileOffset;
+  int32_t transX;
+  int32_t transY;
+  uint16_t width;
+  uint16_t height;
+  uint8_t color[4][3];
+  int16_t tvertexX;
+  int16_t tvertexY;
+  int16_t vramX;
+  int16_t vramY;
+  uint16_t twidth;
+  uint16_t theight;
+};
+
+//a parsed object getObjects copies instead of reading and parsing its file again
+struct s_objectCacheEntry
+{
+  char file[64];
+  struct s_primParam *p_template;
+};
+
+//a texture in vram, every s_texture naming its file at the same vram origin shares the page id. refCount 0 is a free entry
+struct s_textureEntry
+{
+  char file[64];
+  unsigned short id;
+  struct s_svertex vramVertex;
+  struct s_dimensions dimensions;
+  int refCount;
+};
+
+//rotation and scale part of a matrix built for one rotation and scale
+struct s_rotCacheEntry
+{
+  struct s_svertex rotCoor;
+  struct s_lvertex scaleCoor;
+  struct s_matrix matrix;
+  uint8_t valid;
+};
+
+//a run of primitives linked once into a chain per buffer, members is 0 for a free group
+struct s_staticGroup
+{
+  int start;
+  int count;
+  int members;
+  int otIndex;
+  void *p_head[MAX_BUF];
+  void *p_tail[MAX_BUF];
+};
+
+//grid of tile indexes, row by row, drawn as sprites cut from one texture. only tiles in view get a packet,
+//from a ring per buffer big enough to cover the screen.
+struct s_tilemap
+{
+  uint8_t *p_tiles;
+  int width;
+  int height;
+  int tileSize;
+  int tilesPerRow;
+  struct s_texture *p_texture;
+  int ringSize;
+  SPRT_16 *p_ring[MAX_BUF];
+  DR_TPAGE *p_tpage[MAX_BUF];
+};
+
+//spatial grid link of a primitive, cell under the center of its world box
+struct s_gridNode
+{
+  int next;
+  int prev;
+  int16_t cellX;
+  int16_t cellY;
+  uint8_t linked;
+};
+
+struct s_environment;
+
+//fixed rate update job, run every rate ticks by runJobs
+struct s_job
+{
+  void (*p_update)(struct s_environment *p_env);
+  int rate;
 };
 
 struct s_environment
@@ -183,14 +406,112 @@ struct s_environment
   int primCur;
   int primSize;
   int otSize;
+  //far depth, the otz (sz / 4, 1 to 16383) SORT_DEPTH maps to the last ordering table slot, lower it to spread a
+  //shallow scene over the whole table
+  int otzMax;
   int bufSize;
   int prevTime;
   
+  enum en_sortMode sortMode;
+  
+  enum en_frameMode frameMode;
+  
+  enum en_cameraMode cameraMode;
+  
+  //project with RotTransPers library calls instead of the inline gte fast path, for debugging
+  int useGteLibrary;
+  
+  //write and link primitives one by one in index order, each loading its whole matrix, to compare against the batches
+  int noBatches;
+  
+  //only restore and redraw the part of the screen that changed, needs a background layer to restore from.
+  //textRect is the screen area FntPrint writes to, it is redrawn every frame. initEnv sets it to the whole font
+  //window, which leaves little to skip, size it to the lines printed.
+  int useDirtyRect;
+  RECT textRect;
+  
+  //frames handed to the gpu
+  uint32_t frameNum;
+  
+  //scheduler, vsyncTicks is counted by the vsync callback, tick is the last one runJobs ran
+  struct
+  {
+    volatile uint32_t vsyncTicks;
+    uint32_t tick;
+    int vsyncRate;
+    int remain;
+    int jobCount;
+    struct s_job job[MAX_JOBS];
+  } sched;
+  
+  //primitives linked and skipped by the last updatePrim, how often it loaded a rotation into the gte,
+  //how many were placed by the 2D path, how many went in untouched with static groups, how many dirty rect
+  //mode left as they were drawn and how many tiles of the tilemap were in view
+  struct
+  {
+    int drawn;
+    int culled;
+    int rotLoads;
+    int flat;
+    int statics;
+    int kept;
+    int tiles;
+  } primStats;
+  
+  struct s_staticGroup staticGroup[MAX_STATIC_GROUPS];
+  
+  //prerendered background layer, vram holds the composed primitives and worldCoor is where its top left sits
+  //in the world. members is 0 when there is none.
+  struct
+  {
+    int start;
+    int count;
+    int members;
+    RECT vram;
+    struct s_lvertex worldCoor;
+  } background;
+  
+  struct s_tilemap tilemap;
+  
+  //spatial grid, every primitive with a world box sits in the list of its cell's bucket. maxExtent is the
+  //largest box put in, queries reach out that far to find boxes centered outside of them.
+  struct
+  {
+    int head[GRID_BUCKETS];
+    long maxExtent;
+    struct s_gridNode *p_node;
+  } grid;
+  
+  //matrices shared by primitives with the same rotation and scale, hits and misses count up
+  //over a frame and display moves them to lastHits and lastMisses
+  struct
+  {
+    int hits;
+    int misses;
+    int lastHits;
+    int lastMisses;
+    struct s_rotCacheEntry entry[ROT_CACHE_SIZE];
+  } rotCache;
+  
+  //textures in vram, loads counts files uploaded and shares the textures handed an already resident one
+  struct
+  {
+    int loads;
+    int shares;
+    struct s_textureEntry entry[TEXTURE_CACHE_SIZE];
+  } textures;
+  
   struct s_lvertex screenCoor;
   
   struct s_primParam **p_primParam;
   
-  struct s_buffer buffer[DOUBLE_BUF];
+  //primitive indexes grouped by type, bucketStart[type] to bucketStart[type + 1] is one batch
+  int *p_bucket;
+  int bucketStart[TYPE_COUNT + 1];
+  
+  struct s_primArena arena;
+  
+  struct s_buffer buffer[MAX_BUF];
   
   struct s_buffer *p_currBuffer;
   
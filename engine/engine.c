@@ -39,12 +39,143 @@ u_long __ramsize = 0x00200000;  //force 2 megabytes of RAM
 u_long __stacksize = 0x00004000; //force 16 kilobytes of stack
 
 #define BUFSIZE 2048
+//largest packet a primitive slot can need, used to size the arena before the scene types are known
+#define ARENA_SLOT_SIZE sizeof(POLY_GT4)
+
+//spatial grid bucket of a cell, the world is tiled with the buckets so neighbouring cells never share one
+#define GRID_BUCKET(cellX, cellY) (((cellX) & ((1 << GRID_BUCKET_SHIFT) - 1)) + (((cellY) & ((1 << GRID_BUCKET_SHIFT) - 1)) << GRID_BUCKET_SHIFT))
+
+//environment the draw and vsync callbacks work on, set by initEnv
+struct s_environment *g_p_frameEnv = NULL;
+
+//parsed objects by file name, next is the entry replaced when all are taken. kept across environments until flushObjects
+struct
+{
+  int hits;
+  int misses;
+  int next;
+  struct s_objectCacheEntry entry[OBJECT_CACHE_SIZE];
+} g_objectCache;
+
+//vram origin of each buffer's draw area, the third sits right of the texture pages at 320 to 640
+int const gc_bufOrigin[MAX_BUF][2] = {{0, SCREEN_HEIGHT}, {0, 0}, {640, 0}};
+
+//packet layout of every type, same order as en_primType
+struct s_primTraits const gc_primTraits[TYPE_COUNT] =
+{
+  //TYPE_F4
+  {sizeof(POLY_F4), (void (*)(void *))SetPolyF4,
+   4, {offsetof(POLY_F4, x0), offsetof(POLY_F4, x1), offsetof(POLY_F4, x2), offsetof(POLY_F4, x3)}, NO_FIELD,
+   1, {offsetof(POLY_F4, r0)},
+   0, {0},
+   NO_FIELD, 0},
+  //TYPE_FT4
+  {sizeof(POLY_FT4), (void (*)(void *))SetPolyFT4,
+   4, {offsetof(POLY_FT4, x0), offsetof(POLY_FT4, x1), offsetof(POLY_FT4, x2), offsetof(POLY_FT4, x3)}, NO_FIELD,
+   1, {offsetof(POLY_FT4, r0)},
+   4, {offsetof(POLY_FT4, u0), offsetof(POLY_FT4, u1), offsetof(POLY_FT4, u2), offsetof(POLY_FT4, u3)},
+   offsetof(POLY_FT4, tpage), 0},
+  //TYPE_G4
+  {sizeof(POLY_G4), (void (*)(void *))SetPolyG4,
+   4, {offsetof(POLY_G4, x0), offsetof(POLY_G4, x1), offsetof(POLY_G4, x2), offsetof(POLY_G4, x3)}, NO_FIELD,
+   4, {offsetof(POLY_G4, r0), offsetof(POLY_G4, r1), offsetof(POLY_G4, r2), offsetof(POLY_G4, r3)},
+   0, {0},
+   NO_FIELD, 0},
+  //TYPE_GT4
+  {sizeof(POLY_GT4), (void (*)(void *))SetPolyGT4,
+   4, {offsetof(POLY_GT4, x0), offsetof(POLY_GT4, x1), offsetof(POLY_GT4, x2), offsetof(POLY_GT4, x3)}, NO_FIELD,
+   4, {offsetof(POLY_GT4, r0), offsetof(POLY_GT4, r1), offsetof(POLY_GT4, r2), offsetof(POLY_GT4, r3)},
+   4, {offsetof(POLY_GT4, u0), offsetof(POLY_GT4, u1), offsetof(POLY_GT4, u2), offsetof(POLY_GT4, u3)},
+   offsetof(POLY_GT4, tpage), 0},
+  //TYPE_SPRITE
+  {sizeof(SPRT), (void (*)(void *))SetSprt,
+   1, {offsetof(SPRT, x0)}, offsetof(SPRT, w),
+   1, {offsetof(SPRT, r0)},
+   1, {offsetof(SPRT, u0)},
+   NO_FIELD, 1},
+  //TYPE_TILE
+  {sizeof(TILE), (void (*)(void *))SetTile,
+   1, {offsetof(TILE, x0)}, offsetof(TILE, w),
+   1, {offsetof(TILE, r0)},
+   0, {0},
+   NO_FIELD, 0}
+};
 
 //utility functions
-//swap buffer, if the current buffer equals to first, move to the next, else use the first
+//swap buffer, move on to the next buffer, back to the first after the last
 void swapBuffers(struct s_environment *p_env)
 {
-  p_env->p_currBuffer = (p_env->p_currBuffer == p_env->buffer ? p_env->buffer + 1 : p_env->buffer);
+  p_env->p_currBuffer = p_env->buffer + ((p_env->p_currBuffer - p_env->buffer + 1) % p_env->bufSize);
+}
+
+//everything queued to the gpu is drawn, so buffers being drawn are ready to be shown
+void readyBuffers(struct s_environment *p_env)
+{
+  int index;
+  
+  for(index = 0; index < p_env->bufSize; index++)
+  {
+    if(p_env->buffer[index].state == BUF_DRAWING)
+    {
+      p_env->buffer[index].state = BUF_READY;
+    }
+  }
+}
+
+//put the oldest ready buffer on screen so frames are shown in order, the one it replaces is free again
+void showBuffer(struct s_environment *p_env)
+{
+  int index;
+  
+  struct s_buffer *p_show = NULL;
+  
+  for(index = 0; index < p_env->bufSize; index++)
+  {
+    if((p_env->buffer[index].state == BUF_READY) && ((p_show == NULL) || (p_env->buffer[index].frameNum < p_show->frameNum)))
+    {
+      p_show = &p_env->buffer[index];
+    }
+  }
+  
+  if(p_show == NULL)
+  {
+    return;
+  }
+  
+  for(index = 0; index < p_env->bufSize; index++)
+  {
+    if(p_env->buffer[index].state == BUF_SHOWN)
+    {
+      p_env->buffer[index].state = BUF_FREE;
+    }
+  }
+  
+  PutDispEnv(&p_show->disp);
+  
+  p_show->state = BUF_SHOWN;
+}
+
+//draw sync callback for the pipelined display
+void drawDone()
+{
+  readyBuffers(g_p_frameEnv);
+}
+
+//vsync callback, counts logical ticks (a PAL field is 1.2 ticks) and flips the pipelined display during vertical blank
+void vsyncTick()
+{
+  g_p_frameEnv->sched.remain += TICK_RATE;
+  
+  while(g_p_frameEnv->sched.remain >= g_p_frameEnv->sched.vsyncRate)
+  {
+    g_p_frameEnv->sched.vsyncTicks++;
+    g_p_frameEnv->sched.remain -= g_p_frameEnv->sched.vsyncRate;
+  }
+  
+  if(g_p_frameEnv->frameMode == FRAME_PIPELINED)
+  {
+    showBuffer(g_p_frameEnv);
+  }
 }
 
 //for debugging matrixs. Prints all info to debug console
@@ -72,648 +203,2544 @@ void clearVRAM()
   printf("\nDONE CLEARING VRAM\n");
 }
 
-//available functions
-//init environment
-void initEnv(struct s_environment *p_env, int numPrim)
+//traits of a primitive type, NULL if the type is unknown
+struct s_primTraits const *getPrimTraits(enum en_primType type)
+{
+  if(((int)type < 0) || (type >= TYPE_COUNT))
+  {
+    printf("\nUnknown primitive type %d\n", type);
+    return NULL;
+  }
+  
+  return &gc_primTraits[type];
+}
+
+//size of the gpu packet needed for each primitive type
+uint32_t getPrimSize(enum en_primType type)
+{
+  struct s_primTraits const *p_traits = getPrimTraits(type);
+  
+  return (p_traits == NULL ? 0 : p_traits->size);
+}
+
+//carve packets for every object out of the arena, buffer by buffer so one frame's packets sit together.
+//only slots without a packet get one, so this can be called by every populate function. returns -1 if the arena ran out.
+int allocPrimitives(struct s_environment *p_env)
+{
+  int index;
+  int buffIndex;
+  struct s_primTraits const *p_traits;
+  
+  for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
+  {
+    for(index = 0; index < p_env->primSize; index++)
+    {
+      if(p_env->p_primParam[index] == NULL || p_env->buffer[buffIndex].p_primitive[index].data != NULL)
+      {
+	continue;
+      }
+      
+      p_traits = getPrimTraits(p_env->p_primParam[index]->type);
+      
+      if(p_traits == NULL)
+      {
+	continue;
+      }
+      
+      p_env->buffer[buffIndex].p_primitive[index].type = p_env->p_primParam[index]->type;
+      p_env->buffer[buffIndex].p_primitive[index].data = allocArena(p_env, p_traits->size);
+      
+      //sprites carry their own texture page packet, one per buffer so each ordering table links its own
+      if(p_traits->tpagePacket && (p_env->buffer[buffIndex].p_primitive[index].data != NULL))
+      {
+	p_env->buffer[buffIndex].p_primitive[index].p_tpage = allocArena(p_env, sizeof(DR_TPAGE));
+	
+	if(p_env->buffer[buffIndex].p_primitive[index].p_tpage == NULL)
+	{
+	  p_env->buffer[buffIndex].p_primitive[index].data = NULL;
+	}
+      }
+      
+      //the rest would not fit either, allocArena already printed what was short
+      if(p_env->buffer[buffIndex].p_primitive[index].data == NULL)
+      {
+	printf("\nNO PACKET FOR INDEX %d, BUFFER %d\n", index, buffIndex);
+	return -1;
+      }
+    }
+  }
+  
+  return 0;
+}
+
+//set the gte matrix of the primitive from its rotation, scale and real coordinates, the rotation and scale part comes from the cache
+void buildMatrix(struct s_environment *p_env, struct s_primParam *p_primParam)
+{
+  int key;
+  struct s_svertex rotCoor;
+  struct s_rotCacheEntry *p_entry;
+  
+  rotCoor.vx = p_primParam->rotCoor.vx & ROT_ANGLE_MASK;
+  rotCoor.vy = p_primParam->rotCoor.vy & ROT_ANGLE_MASK;
+  rotCoor.vz = p_primParam->rotCoor.vz & ROT_ANGLE_MASK;
+  rotCoor.pad = 0;
+  
+  //mix the angles down so steps of a large power of two (rotSqrs turns by 128) still spread over the entries
+  key = (rotCoor.vx * 31) + (rotCoor.vy * 17) + rotCoor.vz + p_primParam->scaleCoor.vx + p_primParam->scaleCoor.vy + p_primParam->scaleCoor.vz;
+  key = (key ^ (key >> 5) ^ (key >> 10)) & (ROT_CACHE_SIZE - 1);
+  
+  p_entry = &p_env->rotCache.entry[key];
+  
+  if(p_entry->valid &&
+     (memcmp(&p_entry->rotCoor, &rotCoor, sizeof(rotCoor)) == 0) &&
+     (p_entry->scaleCoor.vx == p_primParam->scaleCoor.vx) &&
+     (p_entry->scaleCoor.vy == p_primParam->scaleCoor.vy) &&
+     (p_entry->scaleCoor.vz == p_primParam->scaleCoor.vz))
+  {
+    p_env->rotCache.hits++;
+  }
+  else
+  {
+    //direct mapped, a miss replaces whatever was in the entry
+    RotMatrix((SVECTOR *)&rotCoor, (MATRIX *)&p_entry->matrix);
+    ScaleMatrixL((MATRIX *)&p_entry->matrix, (VECTOR *)&p_primParam->scaleCoor);
+    
+    p_entry->rotCoor = rotCoor;
+    p_entry->scaleCoor = p_primParam->scaleCoor;
+    p_entry->valid = 1;
+    
+    p_env->rotCache.misses++;
+  }
+  
+  memcpy(p_primParam->matrix.m, p_entry->matrix.m, sizeof(p_primParam->matrix.m));
+  
+  TransMatrix((MATRIX *)&p_primParam->matrix, (VECTOR *)&p_primParam->realCoor);
+  
+  p_primParam->prevRotCoor = p_primParam->rotCoor;
+  p_primParam->prevScaleCoor = p_primParam->scaleCoor;
+}
+
+//2D path, no rotation or scale at z = 0 projects one to one, so screen xy is the real coordinate plus the local vertex.
+//returns the otz the gte would have given.
+long writePrimFlat(struct s_primTraits const *p_traits, struct s_primitive *p_primitive, struct s_primParam *p_primParam)
+{
+  int index;
+  int16_t *p_xy;
+  struct s_svertex *p_vertex[4];
+  
+  p_vertex[0] = &p_primParam->vertex0;
+  p_vertex[1] = &p_primParam->vertex1;
+  p_vertex[2] = &p_primParam->vertex2;
+  p_vertex[3] = &p_primParam->vertex3;
+  
+  for(index = 0; index < p_traits->numVertex; index++)
+  {
+    p_xy = (int16_t *)((uint8_t *)p_primitive->data + p_traits->xy[index]);
+    
+    p_xy[0] = p_primParam->realCoor.vx + p_vertex[index]->vx;
+    p_xy[1] = p_primParam->realCoor.vy + p_vertex[index]->vy;
+  }
+  
+  return p_primParam->vertex0.vz >> 2;
+}
+
+//group primitive indexes by type so updatePrim can run each type as one batch, types are fixed after populateOT.
+//members of static groups and the background layer are left out.
+void sortBuckets(struct s_environment *p_env)
 {
   int index;
+  int type;
   int bufIndex;
+  int count[TYPE_COUNT];
   
-  //setup struct
-  memset(p_env, 0, sizeof(*p_env));
-  p_env->bufSize = DOUBLE_BUF;
-  p_env->otSize = (numPrim < 1 ? 1 : numPrim);
-  p_env->primSize = p_env->otSize;
-  p_env->primCur = 0;
-  p_env->prevTime = 0;
-  p_env->p_primParam = NULL;
+  memset(count, 0, sizeof(count));
   
-  //allocate ordering table and primitive list
+  //what updatePrim draws changed, dirty rect mode has to redraw every buffer whole
   for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
   {
-    p_env->buffer[bufIndex].p_primitive = calloc(p_env->otSize, sizeof(struct s_primitive));
-    p_env->buffer[bufIndex].p_ot = calloc(p_env->otSize, sizeof(unsigned long));
+    p_env->buffer[bufIndex].full = 0;
   }
   
-  //allocate number of primitives
-  p_env->p_primParam = calloc(p_env->otSize, sizeof(struct s_primParam));
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    if((p_env->p_primParam[index] != NULL) && (p_env->buffer[0].p_primitive[index].data != NULL) && !(p_env->p_primParam[index]->flags & (PRIM_FLAG_STATIC | PRIM_FLAG_LAYER)))
+    {
+      count[p_env->p_primParam[index]->type]++;
+    }
+  }
   
-  // within the BIOS, if the address 0xBFC7FF52 equals 'E', set it as PAL (1). Otherwise, set it as NTSC (0)
-  switch(*(char *)0xbfc7ff52=='E')
+  p_env->bucketStart[0] = 0;
+  
+  for(type = 0; type < TYPE_COUNT; type++)
   {
-    case 'E':
-      SetVideoMode(MODE_PAL); 
-      break;
-    default:
-      SetVideoMode(MODE_NTSC); 
-      break;	
+    p_env->bucketStart[type + 1] = p_env->bucketStart[type] + count[type];
+    count[type] = p_env->bucketStart[type];
   }
   
-  //reset graphics
-  ResetCallback();
-  ResetGraph(0);
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    if((p_env->p_primParam[index] != NULL) && (p_env->buffer[0].p_primitive[index].data != NULL) && !(p_env->p_primParam[index]->flags & (PRIM_FLAG_STATIC | PRIM_FLAG_LAYER)))
+    {
+      p_env->p_bucket[count[p_env->p_primParam[index]->type]++] = index;
+    }
+  }
+}
 
-  //setup graphics double buffering 
-  SetDefDispEnv(&p_env->buffer[0].disp, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-  SetDefDrawEnv(&p_env->buffer[0].draw, 0, SCREEN_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT);
-  SetDefDispEnv(&p_env->buffer[1].disp, 0, SCREEN_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT);
-  SetDefDrawEnv(&p_env->buffer[1].draw, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+//write screen coordinates to the packet, gte matrix must already be set. the only per frame write.
+//uses the inline gte fast path unless useGteLibrary is set. returns the otz of the primitive.
+long writePrimGeometry(struct s_environment *p_env, struct s_primTraits const *p_traits, struct s_primitive *p_primitive, SVECTOR *p_vertex0, SVECTOR *p_vertex1, SVECTOR *p_vertex2, SVECTOR *p_vertex3)
+{
+  long depthCue;
+  long flag;
+  uint8_t *p_data = (uint8_t *)p_primitive->data;
+  
+  if(!p_env->useGteLibrary)
+  {
+    if(p_traits->numVertex == 1)
+    {
+      return gtePoint(p_vertex0, (long *)(p_data + p_traits->xy[0]));
+    }
+    
+    return gteQuad(p_vertex0, p_vertex1, p_vertex2, p_vertex3,
+		   (long *)(p_data + p_traits->xy[0]),
+		   (long *)(p_data + p_traits->xy[1]),
+		   (long *)(p_data + p_traits->xy[2]),
+		   (long *)(p_data + p_traits->xy[3]));
+  }
+  
+  if(p_traits->numVertex == 1)
+  {
+    return RotTransPers(p_vertex0, (long *)(p_data + p_traits->xy[0]), &depthCue, &flag);
+  }
+  
+  return RotTransPers4(p_vertex0,
+		       p_vertex1,
+		       p_vertex2,
+		       p_vertex3,
+		       (long *)(p_data + p_traits->xy[0]),
+		       (long *)(p_data + p_traits->xy[1]),
+		       (long *)(p_data + p_traits->xy[2]),
+		       (long *)(p_data + p_traits->xy[3]),
+		       &depthCue, &flag);
+}
 
-  //setup draw environment for both buffers
-  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+//write colors to the packet
+void writePrimColor(struct s_primitive *p_primitive, struct s_primParam *p_primParam)
+{
+  int index;
+  uint8_t *p_rgb;
+  struct s_color *p_color[4];
+  struct s_primTraits const *p_traits = &gc_primTraits[p_primitive->type];
+  
+  p_color[0] = &p_primParam->color0;
+  p_color[1] = &p_primParam->color1;
+  p_color[2] = &p_primParam->color2;
+  p_color[3] = &p_primParam->color3;
+  
+  for(index = 0; index < p_traits->numColor; index++)
   {
-    //black background, and isbg set to reset when a new draw starts
-    p_env->buffer[bufIndex].draw.isbg = 1;
-    p_env->buffer[bufIndex].draw.r0 = 0;
-    p_env->buffer[bufIndex].draw.g0 = 0;
-    p_env->buffer[bufIndex].draw.b0 = 0;
+    p_rgb = (uint8_t *)p_primitive->data + p_traits->rgb[index];
     
-    //clear ordering table
-    ClearOTag(p_env->buffer[bufIndex].p_ot, p_env->otSize);
+    p_rgb[0] = p_color[index]->r;
+    p_rgb[1] = p_color[index]->g;
+    p_rgb[2] = p_color[index]->b;
   }
+}
+
+//write texture coordinates to the packet, non textured types have nothing to do
+void writePrimUV(struct s_primitive *p_primitive, struct s_primParam *p_primParam)
+{
+  int index;
+  uint8_t *p_uv;
+  struct s_primTraits const *p_traits = &gc_primTraits[p_primitive->type];
   
-  //set current buffer
-  p_env->p_currBuffer = p_env->buffer;
+  if(p_primParam->p_texture == NULL)
+  {
+    return;
+  }
   
-  //setup geometry
-  InitGeom();
+  //corners go top left, top right, bottom left, bottom right like setUVWH
+  for(index = 0; index < p_traits->numUV; index++)
+  {
+    p_uv = (uint8_t *)p_primitive->data + p_traits->uv[index];
+    
+    p_uv[0] = p_primParam->p_texture->vertex0.vx + ((index & 1) ? p_primParam->p_texture->dimensions.w : 0);
+    p_uv[1] = p_primParam->p_texture->vertex0.vy + ((index & 2) ? p_primParam->p_texture->dimensions.h : 0);
+  }
+}
+
+//write the fields that do not change from frame to frame, done once per buffer by populateOT
+void writePrimStatic(struct s_primitive *p_primitive, struct s_primParam *p_primParam)
+{
+  struct s_primTraits const *p_traits = &gc_primTraits[p_primitive->type];
   
-  SetGraphDebug(0); //0 = no checks, 1 = checks, 2 = dump of registered and drawn
+  p_traits->p_init(p_primitive->data);
   
-  SetGeomScreen(1024); // this sets distance h (eye to screen)
+  if(p_traits->wh != NO_FIELD)
+  {
+    ((int16_t *)((uint8_t *)p_primitive->data + p_traits->wh))[0] = p_primParam->dimensions.w;
+    ((int16_t *)((uint8_t *)p_primitive->data + p_traits->wh))[1] = p_primParam->dimensions.h;
+  }
   
-  //CD init 
-  DsInit();
+  writePrimColor(p_primitive, p_primParam);
+  writePrimUV(p_primitive, p_primParam);
+}
+
+//point the packet at its texture page, in the packet itself or in the DR_TPAGE linked in front of it
+void bindPrimTexture(struct s_primitive *p_primitive, struct s_primParam *p_primParam)
+{
+  struct s_primTraits const *p_traits = &gc_primTraits[p_primitive->type];
   
-  //sound
-  SpuInit();
+  if(p_traits->tpage != NO_FIELD)
+  {
+    *(uint16_t *)((uint8_t *)p_primitive->data + p_traits->tpage) = p_primParam->p_texture->id;
+  }
+  else if(p_traits->tpagePacket && (p_primitive->p_tpage != NULL))
+  {
+    SetDrawTPage((DR_TPAGE *)p_primitive->p_tpage, 1, 0, p_primParam->p_texture->id);
+  }
+}
+
+//write every part of a packet outside of the batches, the whole matrix is loaded for each one. returns its otz.
+long writePrimAll(struct s_environment *p_env, struct s_primitive *p_primitive, struct s_primParam *p_primParam)
+{
+  long otz;
+  struct s_primTraits const *p_traits;
   
-  //game pad
-  PadInitDirect((u_char *)&p_env->gamePad.one, (u_char *)&p_env->gamePad.two);
-  PadStartCom();
+  p_traits = getPrimTraits(p_primParam->type);
   
-  //get prim data
-  initGetPrimData();
+  if(p_primParam->flags & PRIM_FLAG_2D)
+  {
+    otz = writePrimFlat(p_traits, p_primitive, p_primParam);
+  }
+  else
+  {
+    SetRotMatrix((MATRIX *)&p_primParam->matrix);
+    SetTransMatrix((MATRIX *)&p_primParam->matrix);
+    
+    otz = writePrimGeometry(p_env, p_traits, p_primitive, (SVECTOR *)&p_primParam->vertex0, (SVECTOR *)&p_primParam->vertex1, (SVECTOR *)&p_primParam->vertex2, (SVECTOR *)&p_primParam->vertex3);
+  }
   
-  AddSIO(9600);
+  writePrimColor(p_primitive, p_primParam);
+  writePrimUV(p_primitive, p_primParam);
   
-  clearVRAM();
+  return otz;
+}
+
+//ordering table slot of a primitive, the table is reversed so higher slots are drawn first (further away)
+int getOTindex(struct s_environment *p_env, struct s_primParam *p_primParam)
+{
+  long key;
   
-  //font print debug info
-  FntLoad(960, 256);
-  SetDumpFnt(FntOpen(5, 20, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 512));
+  if(p_primParam->flags & PRIM_FLAG_BACKGROUND)
+  {
+    return p_env->otSize - 1;
+  }
   
-  //allow display to be seen
-  SetDispMask(1); 
+  switch(p_env->sortMode)
+  {
+    case SORT_Y:
+      //2.5D, the lower the foot of the primitive is on screen the closer it is
+      key = p_primParam->transCoor.vy + (int32_t)p_primParam->dimensions.h - p_env->screenCoor.vy;
+      key = (key < 0 ? 0 : (key >= SCREEN_HEIGHT ? SCREEN_HEIGHT - 1 : key));
+      key = (p_env->otSize - 1) - (key * (p_env->otSize - 1)) / (SCREEN_HEIGHT - 1);
+      break;
+    case SORT_DEPTH:
+    default:
+      //otz from the gte (sz / 4), scaled so otzMax lands on the last slot, anything further shares it
+      key = (p_primParam->otz * p_env->otSize) / (p_env->otzMax + 1);
+      break;
+  }
+  
+  return (key < 0 ? 0 : (key >= p_env->otSize ? p_env->otSize - 1 : key));
 }
 
-//setup sound for the play station
-void setupSound(struct s_environment *p_env)
-{ 
-  //setup volume and cd into mix
-  p_env->soundAttr.mask = (SPU_COMMON_MVOLL | SPU_COMMON_MVOLR | SPU_COMMON_CDVOLL | SPU_COMMON_CDVOLR | SPU_COMMON_CDMIX);
+//world box of a primitive as left, top, right and bottom, grown to cover scale and rotation. returns 0 for primitives
+//moved off the z = 0 plane, perspective moves them about the projection center so they have no box.
+int getPrimBox(struct s_primParam *p_primParam, long *op_box)
+{
+  long scale;
+  long halfW;
+  long halfH;
+  long centerX;
+  long centerY;
   
-  p_env->soundAttr.mvol.left = 0x1FFF;
-  p_env->soundAttr.mvol.right = 0x1FFF;
+  if(p_primParam->transCoor.vz != 0)
+  {
+    return 0;
+  }
   
-  p_env->soundAttr.cd.volume.left = 0x1FFF;
-  p_env->soundAttr.cd.volume.right = 0x1FFF;
+  halfW = p_primParam->dimensions.w / 2;
+  halfH = p_primParam->dimensions.h / 2;
   
-  p_env->soundAttr.cd.mix = SPU_ON;
+  //transCoor is the top left corner, primitives rotate and scale about their center
+  centerX = p_primParam->transCoor.vx + halfW;
+  centerY = p_primParam->transCoor.vy + halfH;
   
-  //set the spu attributes
-  SpuSetCommonAttr(&p_env->soundAttr);
+  //scale of ONE (4096) is 1.0, use the larger axis
+  scale = (p_primParam->scaleCoor.vx > p_primParam->scaleCoor.vy ? p_primParam->scaleCoor.vx : p_primParam->scaleCoor.vy);
   
-  SpuSetTransferMode(SPU_TRANSFER_BY_DMA);
+  if(scale > ONE)
+  {
+    halfW = (halfW * scale) >> 12;
+    halfH = (halfH * scale) >> 12;
+  }
+  
+  //rotated, the corners can reach as far as the half diagonal in any direction, half width plus half height covers it
+  if(p_primParam->rotCoor.vx || p_primParam->rotCoor.vy || p_primParam->rotCoor.vz)
+  {
+    halfW = halfW + halfH;
+    halfH = halfW;
+  }
+  
+  op_box[0] = centerX - halfW;
+  op_box[1] = centerY - halfH;
+  op_box[2] = centerX + halfW;
+  op_box[3] = centerY + halfH;
+  
+  return 1;
 }
 
-//play CDDA audio tracks
-void playCDtracks(int *p_tracks, int trackNum)
+//check the world box of a primitive against the view at screenCoor, primitives without a box are always visible.
+int isPrimVisible(struct s_environment *p_env, struct s_primParam *p_primParam)
 {
-  if(DsPlay(2, p_tracks, trackNum) < 0)
+  long box[4];
+  
+  if(!getPrimBox(p_primParam, box))
+  {
+    return 1;
+  }
+  
+  if(box[2] < p_env->screenCoor.vx || box[0] >= (p_env->screenCoor.vx + SCREEN_WIDTH))
+  {
+    return 0;
+  }
+  
+  if(box[3] < p_env->screenCoor.vy || box[1] >= (p_env->screenCoor.vy + SCREEN_HEIGHT))
+  {
+    return 0;
+  }
+  
+  return 1;
+}
+
+//grow the screen area in op_area (left, top, right, bottom) to take in rect, empty rects add nothing
+void addDirtyArea(long *op_area, RECT *p_rect)
+{
+  if((p_rect->w <= 0) || (p_rect->h <= 0))
+  {
+    return;
+  }
+  
+  op_area[0] = (p_rect->x < op_area[0] ? p_rect->x : op_area[0]);
+  op_area[1] = (p_rect->y < op_area[1] ? p_rect->y : op_area[1]);
+  op_area[2] = ((p_rect->x + p_rect->w) > op_area[2] ? (p_rect->x + p_rect->w) : op_area[2]);
+  op_area[3] = ((p_rect->y + p_rect->h) > op_area[3] ? (p_rect->y + p_rect->h) : op_area[3]);
+}
+
+//dirty rect mode, work out the screen area of the current buffer that has to be redrawn. a primitive that changed
+//since this buffer was last drawn (its dirty flags are kept per buffer) adds where it was and where it is now.
+//the whole screen is redrawn when there is no background layer to restore from, the camera moved, or the buffer
+//does not hold a whole frame yet.
+void buildDirtyRect(struct s_environment *p_env)
+{
+  int bucketIndex;
+  int bufIndex;
+  long box[4];
+  long area[4];
+  RECT rect;
+  struct s_primParam *p_primParam;
+  
+  bufIndex = p_env->p_currBuffer - p_env->buffer;
+  
+  area[0] = area[1] = 0x7FFFFFFF;
+  area[2] = area[3] = -0x7FFFFFFF;
+  
+  for(bucketIndex = 0; bucketIndex < p_env->bucketStart[TYPE_COUNT]; bucketIndex++)
+  {
+    p_primParam = p_env->p_primParam[p_env->p_bucket[bucketIndex]];
+    
+    //screen box now, clipped to the screen. empty when out of view, the whole screen without a box.
+    if(getPrimBox(p_primParam, box))
+    {
+      box[0] = (box[0] - p_env->screenCoor.vx < 0 ? 0 : box[0] - p_env->screenCoor.vx);
+      box[1] = (box[1] - p_env->screenCoor.vy < 0 ? 0 : box[1] - p_env->screenCoor.vy);
+      box[2] = (box[2] - p_env->screenCoor.vx > SCREEN_WIDTH ? SCREEN_WIDTH : box[2] - p_env->screenCoor.vx);
+      box[3] = (box[3] - p_env->screenCoor.vy > SCREEN_HEIGHT ? SCREEN_HEIGHT : box[3] - p_env->screenCoor.vy);
+      
+      setRECT(&rect, box[0], box[1], (box[2] > box[0] ? box[2] - box[0] : 0), (box[3] > box[1] ? box[3] - box[1] : 0));
+    }
+    else
+    {
+      setRECT(&rect, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+    
+    if(p_primParam->dirty[bufIndex] || (memcmp(&rect, &p_primParam->drawnRect[bufIndex], sizeof(rect)) != 0))
+    {
+      addDirtyArea(area, &p_primParam->drawnRect[bufIndex]);
+      addDirtyArea(area, &rect);
+    }
+    
+    p_primParam->drawnRect[bufIndex] = rect;
+  }
+  
+  //text is printed over every frame and is not tracked
+  addDirtyArea(area, &p_env->textRect);
+  
+  p_env->p_currBuffer->partial = ((p_env->background.members > 0) && p_env->p_currBuffer->full &&
+				  (p_env->p_currBuffer->screenCoor.vx == p_env->screenCoor.vx) &&
+				  (p_env->p_currBuffer->screenCoor.vy == p_env->screenCoor.vy));
+  
+  if(!p_env->p_currBuffer->partial)
+  {
+    setRECT(&p_env->p_currBuffer->dirtyRect, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  }
+  else if((area[2] > area[0]) && (area[3] > area[1]))
+  {
+    setRECT(&p_env->p_currBuffer->dirtyRect, area[0], area[1], area[2] - area[0], area[3] - area[1]);
+  }
+  else
+  {
+    //nothing changed, a one pixel area keeps the draw area valid
+    setRECT(&p_env->p_currBuffer->dirtyRect, 0, 0, 1, 1);
+  }
+  
+  p_env->p_currBuffer->screenCoor = p_env->screenCoor;
+  p_env->p_currBuffer->full = 1;
+}
+
+//rewrite the dirty parts of every visible primitive of the current buffer one type at a time, so each batch runs one
+//transform over the same code, then link them all in index order.
+void updateBatches(struct s_environment *p_env)
+{
+  int type;
+  int bucketIndex;
+  int index;
+  int bufIndex;
+  int otIndex;
+  int rotLoaded;
+  uint8_t dirty;
+  
+  struct s_svertex loadedRot;
+  struct s_lvertex loadedScale;
+  
+  struct s_primitive *p_primitive;
+  struct s_primParam *p_primParam;
+  struct s_primTraits const *p_traits;
+  
+  bufIndex = p_env->p_currBuffer - p_env->buffer;
+  
+  //nothing loaded into the gte yet
+  rotLoaded = 0;
+  
+  for(type = 0; type < TYPE_COUNT; type++)
+  {
+    p_traits = &gc_primTraits[type];
+    
+    for(bucketIndex = p_env->bucketStart[type]; bucketIndex < p_env->bucketStart[type + 1]; bucketIndex++)
+    {
+      index = p_env->p_bucket[bucketIndex];
+      
+      p_primParam = p_env->p_primParam[index];
+      
+      //out of view, leave its packet and dirty flags alone until it comes back
+      if(!isPrimVisible(p_env, p_primParam))
+      {
+	p_primParam->flags |= PRIM_FLAG_CULLED;
+	p_env->primStats.culled++;
+	continue;
+      }
+      
+      //transPrim skipped it while it was out of view, catch the matrix up now
+      if(p_primParam->flags & PRIM_FLAG_CULLED)
+      {
+	p_primParam->flags &= ~PRIM_FLAG_CULLED;
+	transPrim(p_primParam, p_env);
+      }
+      
+      //dirty rect mode, clear of the area being redrawn its pixels are still in the buffer
+      if(p_env->p_currBuffer->partial &&
+	 ((p_primParam->drawnRect[bufIndex].x >= (p_env->p_currBuffer->dirtyRect.x + p_env->p_currBuffer->dirtyRect.w)) ||
+	  ((p_primParam->drawnRect[bufIndex].x + p_primParam->drawnRect[bufIndex].w) <= p_env->p_currBuffer->dirtyRect.x) ||
+	  (p_primParam->drawnRect[bufIndex].y >= (p_env->p_currBuffer->dirtyRect.y + p_env->p_currBuffer->dirtyRect.h)) ||
+	  ((p_primParam->drawnRect[bufIndex].y + p_primParam->drawnRect[bufIndex].h) <= p_env->p_currBuffer->dirtyRect.y)))
+      {
+	p_env->primStats.kept++;
+	continue;
+      }
+      
+      p_env->primStats.drawn++;
+      
+      dirty = p_primParam->dirty[bufIndex];
+      
+      p_primitive = &p_env->p_currBuffer->p_primitive[index];
+      
+      if((dirty & DIRTY_TRANS) && (p_primParam->flags & PRIM_FLAG_2D))
+      {
+	p_primParam->otz = writePrimFlat(p_traits, p_primitive, p_primParam);
+	p_env->primStats.flat++;
+      }
+      else if(dirty & DIRTY_TRANS)
+      {
+	//primitives built from the same rotation and scale share the rotation part, only load it when it changes
+	if(!rotLoaded ||
+	   (memcmp(&p_primParam->prevRotCoor, &loadedRot, sizeof(loadedRot)) != 0) ||
+	   (memcmp(&p_primParam->prevScaleCoor, &loadedScale, sizeof(loadedScale)) != 0))
+	{
+	  SetRotMatrix((MATRIX *)&p_primParam->matrix);
+	  
+	  loadedRot = p_primParam->prevRotCoor;
+	  loadedScale = p_primParam->prevScaleCoor;
+	  rotLoaded = 1;
+	  
+	  p_env->primStats.rotLoads++;
+	}
+	
+	SetTransMatrix((MATRIX *)&p_primParam->matrix);
+	
+	p_primParam->otz = writePrimGeometry(p_env, p_traits, p_primitive, (SVECTOR *)&p_primParam->vertex0, (SVECTOR *)&p_primParam->vertex1, (SVECTOR *)&p_primParam->vertex2, (SVECTOR *)&p_primParam->vertex3);
+      }
+      
+      if(dirty & DIRTY_COLOR)
+      {
+	writePrimColor(p_primitive, p_primParam);
+      }
+      
+      if(dirty & DIRTY_UV)
+      {
+	writePrimUV(p_primitive, p_primParam);
+      }
+      
+      p_primParam->dirty[bufIndex] = 0;
+      
+      p_primParam->flags |= PRIM_FLAG_LINK;
+    }
+  }
+  
+  //linked apart from the batches so primitives of different types sharing a slot still draw in index order.
+  //walk backwards, AddPrim puts each packet in front so primitives sharing a slot keep their index order
+  for(index = p_env->primSize - 1; index >= 0; index--)
+  {
+    p_primParam = p_env->p_primParam[index];
+    
+    if((p_primParam == NULL) || !(p_primParam->flags & PRIM_FLAG_LINK))
+    {
+      continue;
+    }
+    
+    p_primParam->flags &= ~PRIM_FLAG_LINK;
+    
+    p_primitive = &p_env->p_currBuffer->p_primitive[index];
+    
+    otIndex = getOTindex(p_env, p_primParam);
+    
+    AddPrim(&(p_env->p_currBuffer->p_ot[otIndex]), p_primitive->data);
+    
+    //texture page has to be drawn before the sprite that uses it
+    if(p_primitive->p_tpage != NULL)
+    {
+      AddPrim(&(p_env->p_currBuffer->p_ot[otIndex]), p_primitive->p_tpage);
+    }
+  }
+}
+
+//the path before batching, for comparing against updateBatches: every primitive in index order loads its whole
+//matrix, is written and linked on its own. culling, dirty rect and dirty flags work the same.
+void updateUnbatched(struct s_environment *p_env)
+{
+  int index;
+  int bufIndex;
+  int otIndex;
+  uint8_t dirty;
+  
+  struct s_primitive *p_primitive;
+  struct s_primParam *p_primParam;
+  struct s_primTraits const *p_traits;
+  
+  bufIndex = p_env->p_currBuffer - p_env->buffer;
+  
+  //walk backwards, AddPrim puts each packet in front so primitives sharing a slot keep their index order
+  for(index = p_env->primSize - 1; index >= 0; index--)
+  {
+    p_primParam = p_env->p_primParam[index];
+    
+    //same primitives the batches hold
+    if((p_primParam == NULL) || (p_env->buffer[0].p_primitive[index].data == NULL) || (p_primParam->flags & (PRIM_FLAG_STATIC | PRIM_FLAG_LAYER)))
+    {
+      continue;
+    }
+    
+    if(!isPrimVisible(p_env, p_primParam))
+    {
+      p_primParam->flags |= PRIM_FLAG_CULLED;
+      p_env->primStats.culled++;
+      continue;
+    }
+    
+    if(p_primParam->flags & PRIM_FLAG_CULLED)
+    {
+      p_primParam->flags &= ~PRIM_FLAG_CULLED;
+      transPrim(p_primParam, p_env);
+    }
+    
+    if(p_env->p_currBuffer->partial &&
+       ((p_primParam->drawnRect[bufIndex].x >= (p_env->p_currBuffer->dirtyRect.x + p_env->p_currBuffer->dirtyRect.w)) ||
+	((p_primParam->drawnRect[bufIndex].x + p_primParam->drawnRect[bufIndex].w) <= p_env->p_currBuffer->dirtyRect.x) ||
+	(p_primParam->drawnRect[bufIndex].y >= (p_env->p_currBuffer->dirtyRect.y + p_env->p_currBuffer->dirtyRect.h)) ||
+	((p_primParam->drawnRect[bufIndex].y + p_primParam->drawnRect[bufIndex].h) <= p_env->p_currBuffer->dirtyRect.y)))
+    {
+      p_env->primStats.kept++;
+      continue;
+    }
+    
+    p_env->primStats.drawn++;
+    
+    dirty = p_primParam->dirty[bufIndex];
+    
+    p_primitive = &p_env->p_currBuffer->p_primitive[index];
+    
+    p_traits = getPrimTraits(p_primParam->type);
+    
+    if((dirty & DIRTY_TRANS) && (p_primParam->flags & PRIM_FLAG_2D))
+    {
+      p_primParam->otz = writePrimFlat(p_traits, p_primitive, p_primParam);
+      p_env->primStats.flat++;
+    }
+    else if(dirty & DIRTY_TRANS)
+    {
+      SetRotMatrix((MATRIX *)&p_primParam->matrix);
+      SetTransMatrix((MATRIX *)&p_primParam->matrix);
+      
+      p_env->primStats.rotLoads++;
+      
+      p_primParam->otz = writePrimGeometry(p_env, p_traits, p_primitive, (SVECTOR *)&p_primParam->vertex0, (SVECTOR *)&p_primParam->vertex1, (SVECTOR *)&p_primParam->vertex2, (SVECTOR *)&p_primParam->vertex3);
+    }
+    
+    if(dirty & DIRTY_COLOR)
+    {
+      writePrimColor(p_primitive, p_primParam);
+    }
+    
+    if(dirty & DIRTY_UV)
+    {
+      writePrimUV(p_primitive, p_primParam);
+    }
+    
+    p_primParam->dirty[bufIndex] = 0;
+    
+    otIndex = getOTindex(p_env, p_primParam);
+    
+    AddPrim(&(p_env->p_currBuffer->p_ot[otIndex]), p_primitive->data);
+    
+    //texture page has to be drawn before the sprite that uses it
+    if(p_primitive->p_tpage != NULL)
+    {
+      AddPrim(&(p_env->p_currBuffer->p_ot[otIndex]), p_primitive->p_tpage);
+    }
+  }
+}
+
+//link the tiles in view from the current buffer's ring into the deepest slot, cost follows the screen not the map
+void updateTilemap(struct s_environment *p_env)
+{
+  int row;
+  int col;
+  int firstRow;
+  int firstCol;
+  int lastRow;
+  int lastCol;
+  int count;
+  int bufIndex;
+  uint8_t tile;
+  long cameraX;
+  long cameraY;
+  SPRT_16 *p_sprite;
+  struct s_tilemap *p_tilemap;
+  
+  p_tilemap = &p_env->tilemap;
+  
+  bufIndex = p_env->p_currBuffer - p_env->buffer;
+  
+  p_env->primStats.tiles = 0;
+  
+  if((p_tilemap->p_tiles == NULL) || (p_tilemap->p_ring[bufIndex] == NULL))
+  {
+    return;
+  }
+  
+  firstCol = (p_env->screenCoor.vx < 0 ? 0 : p_env->screenCoor.vx / p_tilemap->tileSize);
+  firstRow = (p_env->screenCoor.vy < 0 ? 0 : p_env->screenCoor.vy / p_tilemap->tileSize);
+  lastCol = (p_env->screenCoor.vx + SCREEN_WIDTH - 1) / p_tilemap->tileSize;
+  lastRow = (p_env->screenCoor.vy + SCREEN_HEIGHT - 1) / p_tilemap->tileSize;
+  lastCol = (lastCol >= p_tilemap->width ? p_tilemap->width - 1 : lastCol);
+  lastRow = (lastRow >= p_tilemap->height ? p_tilemap->height - 1 : lastRow);
+  
+  //offset mode has the camera in the draw offset already
+  cameraX = (p_env->cameraMode == CAMERA_TRANSFORM ? p_env->screenCoor.vx : 0);
+  cameraY = (p_env->cameraMode == CAMERA_TRANSFORM ? p_env->screenCoor.vy : 0);
+  
+  count = 0;
+  
+  for(row = firstRow; row <= lastRow; row++)
+  {
+    for(col = firstCol; col <= lastCol; col++)
+    {
+      tile = p_tilemap->p_tiles[(row * p_tilemap->width) + col];
+      
+      if(tile == TILE_EMPTY)
+      {
+	continue;
+      }
+      
+      p_sprite = &p_tilemap->p_ring[bufIndex][count++];
+      
+      setXY0(p_sprite, (col * p_tilemap->tileSize) - cameraX, (row * p_tilemap->tileSize) - cameraY);
+      setUV0(p_sprite, p_tilemap->p_texture->vertex0.vx + (tile % p_tilemap->tilesPerRow) * p_tilemap->tileSize, p_tilemap->p_texture->vertex0.vy + (tile / p_tilemap->tilesPerRow) * p_tilemap->tileSize);
+      
+      AddPrim(&(p_env->p_currBuffer->p_ot[p_env->otSize - 1]), p_sprite);
+    }
+  }
+  
+  //sprites draw with the current texture page, set it ahead of them
+  if(count > 0)
+  {
+    AddPrim(&(p_env->p_currBuffer->p_ot[p_env->otSize - 1]), p_tilemap->p_tpage[bufIndex]);
+  }
+  
+  p_env->primStats.tiles = count;
+}
+
+//available functions
+//init environment
+void initEnv(struct s_environment *p_env, int numPrim, int otSize, int bufCount)
+{
+  int index;
+  int bufIndex;
+  
+  //setup struct
+  memset(p_env, 0, sizeof(*p_env));
+  p_env->bufSize = (bufCount < DOUBLE_BUF ? DOUBLE_BUF : (bufCount > MAX_BUF ? MAX_BUF : bufCount));
+  p_env->primSize = (numPrim < 1 ? 1 : numPrim);
+  p_env->otSize = (otSize < 1 ? OT_DEFAULT_SIZE : otSize);
+  p_env->otzMax = OTZ_DEFAULT_MAX;
+  p_env->sortMode = SORT_DEPTH;
+  p_env->cameraMode = CAMERA_TRANSFORM;
+  p_env->frameMode = FRAME_SYNC;
+  p_env->primCur = 0;
+  p_env->prevTime = 0;
+  p_env->p_primParam = NULL;
+  
+  //allocate ordering table and primitive list
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+  {
+    p_env->buffer[bufIndex].p_primitive = calloc(p_env->primSize, sizeof(struct s_primitive));
+    p_env->buffer[bufIndex].p_ot = calloc(p_env->otSize, sizeof(unsigned long));
+  }
+  
+  //allocate number of primitives
+  p_env->p_primParam = calloc(p_env->primSize, sizeof(struct s_primParam));
+  p_env->p_bucket = calloc(p_env->primSize, sizeof(int));
+  p_env->grid.p_node = calloc(p_env->primSize, sizeof(struct s_gridNode));
+  
+  //empty grid
+  for(index = 0; index < GRID_BUCKETS; index++)
+  {
+    p_env->grid.head[index] = -1;
+  }
+  
+  //allocate packet arena, worst case for every slot until the title sizes it
+  setArenaSize(p_env, p_env->primSize * p_env->bufSize * ARENA_SLOT_SIZE);
+  
+  // within the BIOS, if the address 0xBFC7FF52 equals 'E', set it as PAL (1). Otherwise, set it as NTSC (0)
+  switch(*(char *)0xbfc7ff52)
+  {
+    case 'E':
+      SetVideoMode(MODE_PAL); 
+      p_env->sched.vsyncRate = 50;
+      break;
+    default:
+      SetVideoMode(MODE_NTSC); 
+      p_env->sched.vsyncRate = 60;
+      break;	
+  }
+  
+  //reset graphics
+  ResetCallback();
+  ResetGraph(0);
+  
+  //scheduler ticks and pipelined flips
+  g_p_frameEnv = p_env;
+  VSyncCallback(vsyncTick);
+  
+  PROF_INIT();
+
+  //setup draw environment for every buffer
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+  {
+    //each buffer displays the area it draws to once it is done
+    SetDefDispEnv(&p_env->buffer[bufIndex].disp, gc_bufOrigin[bufIndex][0], gc_bufOrigin[bufIndex][1], SCREEN_WIDTH, SCREEN_HEIGHT);
+    SetDefDrawEnv(&p_env->buffer[bufIndex].draw, gc_bufOrigin[bufIndex][0], gc_bufOrigin[bufIndex][1], SCREEN_WIDTH, SCREEN_HEIGHT);
+    
+    //black background, and isbg set to reset when a new draw starts
+    p_env->buffer[bufIndex].draw.isbg = 1;
+    p_env->buffer[bufIndex].draw.r0 = 0;
+    p_env->buffer[bufIndex].draw.g0 = 0;
+    p_env->buffer[bufIndex].draw.b0 = 0;
+    
+    //clear ordering table, reversed so the deepest slot is drawn first
+    ClearOTagR(p_env->buffer[bufIndex].p_ot, p_env->otSize);
+  }
+  
+  //set current buffer
+  p_env->p_currBuffer = p_env->buffer;
+  
+  //setup geometry
+  InitGeom();
+  
+  SetGraphDebug(0); //0 = no checks, 1 = checks, 2 = dump of registered and drawn
+  
+  SetGeomScreen(1024); // this sets distance h (eye to screen)
+  
+  //CD init 
+  DsInit();
+  
+  //sound
+  SpuInit();
+  
+  //game pad
+  PadInitDirect((u_char *)&p_env->gamePad.one, (u_char *)&p_env->gamePad.two);
+  PadStartCom();
+  
+  //get prim data
+  initGetPrimData();
+  
+  AddSIO(9600);
+  
+  clearVRAM();
+  
+  //font print debug info
+  FntLoad(960, 256);
+  SetDumpFnt(FntOpen(5, 20, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 512));
+  
+  //text can go anywhere in the font window until the title narrows it down
+  setRECT(&p_env->textRect, 5, 20, SCREEN_WIDTH - 5, SCREEN_HEIGHT - 20);
+  
+  //allow display to be seen
+  SetDispMask(1); 
+}
+
+//setup sound for the play station
+void setupSound(struct s_environment *p_env)
+{ 
+  //setup volume and cd into mix
+  p_env->soundAttr.mask = (SPU_COMMON_MVOLL | SPU_COMMON_MVOLR | SPU_COMMON_CDVOLL | SPU_COMMON_CDVOLR | SPU_COMMON_CDMIX);
+  
+  p_env->soundAttr.mvol.left = 0x1FFF;
+  p_env->soundAttr.mvol.right = 0x1FFF;
+  
+  p_env->soundAttr.cd.volume.left = 0x1FFF;
+  p_env->soundAttr.cd.volume.right = 0x1FFF;
+  
+  p_env->soundAttr.cd.mix = SPU_ON;
+  
+  //set the spu attributes
+  SpuSetCommonAttr(&p_env->soundAttr);
+  
+  SpuSetTransferMode(SPU_TRANSFER_BY_DMA);
+}
+
+//play CDDA audio tracks
+void playCDtracks(int *p_tracks, int trackNum)
+{
+  if(DsPlay(2, p_tracks, trackNum) < 0)
+  {
+    printf("\nNo CD Track Playing\n");
+  }
+  
+  printf("\nCurrent Track: %d\n", DsPlay(3, p_tracks, 1));
+}
+
+//update display
+void display(struct s_environment *p_env)
+{
+  if(p_env->frameMode == FRAME_PIPELINED)
+  {
+    //the area about to be drawn to can not be on screen, only waits when the gpu or vsync is behind
+    PROF_BEGIN(PROF_DISPLAY_WAIT);
+    while((p_env->p_currBuffer->state == BUF_READY) || (p_env->p_currBuffer->state == BUF_SHOWN));
+    PROF_END(PROF_DISPLAY_WAIT);
+  }
+  else
+  {
+    //avoid issues with delayed execution
+    PROF_BEGIN(PROF_GPU);
+    while(DrawSync(1));
+    PROF_END(PROF_GPU);
+    
+    PROF_BEGIN(PROF_DISPLAY_WAIT);
+    VSync(0);
+    PROF_END(PROF_DISPLAY_WAIT);
+    
+    //font flush now so contents get drawn
+    FntFlush(-1);
+    
+    //put the last buffer drawn up
+    readyBuffers(p_env);
+    showBuffer(p_env);
+  }
+  
+  p_env->p_currBuffer->state = BUF_DRAWING;
+  p_env->p_currBuffer->frameNum = ++p_env->frameNum;
+  
+  //start drawings in the current buffer's area, reversed table so start from the last slot
+  DrawOTagEnv(p_env->p_currBuffer->p_ot + p_env->otSize - 1, &p_env->p_currBuffer->draw);
+  
+  //pipelined font is queued right behind the table so it lands on the frame it was printed for
+  if(p_env->frameMode == FRAME_PIPELINED)
+  {
+    FntFlush(-1);
+  }
+  
+  //exchange reg and draw buffer, so newly registered ot will be drawn, and used draw buffer can now be used for registration.
+  swapBuffers(p_env);
+  
+  //rotation cache counts of the frame just handed over
+  p_env->rotCache.lastHits = p_env->rotCache.hits;
+  p_env->rotCache.lastMisses = p_env->rotCache.misses;
+  p_env->rotCache.hits = 0;
+  p_env->rotCache.misses = 0;
+  
+  //write header before all other font prints
+  FntPrint("%s\n%s\n%X", p_env->envMessage.p_title, p_env->envMessage.p_message, *p_env->envMessage.p_data);
+  
+  //zone stats of the last frames, then start timing the next frame
+  PROF_PRINT();
+  PROF_FRAME_END();
+}
+
+//load a bitmap texture from CD to vram at its vramVertex, its id is set to the texture page
+int loadTexture(struct s_texture *p_texture)
+{
+  int returnValue = 0;
+  
+  //load texture file from CD
+  p_texture->p_data = (uint8_t *)loadFileFromCD(p_texture->file, &(p_texture->size));
+  
+  if(p_texture->p_data == NULL)
+  {
+    return -1;
+  }
+  
+  printf("\nGETTING RAW\n");
+  
+  //convert bitmaps to raw data
+  returnValue = bitmapToRAW(&(p_texture->p_data), p_texture->size, p_texture->dimensions.w, p_texture->dimensions.h);
+  
+  if(returnValue > 0)
+  {
+    p_texture->size = returnValue;
+  }
+  else if(returnValue < 0)
+  {
+    printf("\nBAD DATA\n");
+    return -1;
+  }
+  
+  //convert color space
+  if(swapRedBlue(p_texture->p_data, p_texture->size) < 0)
+  {
+    printf("\nSWAP FAILED\n");
+    return -1;
+  }
+  
+  //load via LoadTPage (can also be done with loadImage, and some checking that transfer is over, then use getIDtpage.
+  p_texture->id = LoadTPage((u_long *)p_texture->p_data, 2, 0, p_texture->vramVertex.vx, p_texture->vramVertex.vy, p_texture->dimensions.w, p_texture->dimensions.h);
+  
+  //wait for transfer to finish
+  while(DrawSync(1));
+  
+  //data transfered, free some memory
+  free(p_texture->p_data);
+  p_texture->p_data = NULL;
+  
+  return 0;
+}
+
+//get a texture into vram, a file already resident at the same vram origin shares its page id instead of being loaded again
+int acquireTexture(struct s_environment *p_env, struct s_texture *p_texture)
+{
+  int index;
+  struct s_textureEntry *p_entry;
+  struct s_textureEntry *p_free = NULL;
+  
+  for(index = 0; index < TEXTURE_CACHE_SIZE; index++)
+  {
+    p_entry = &p_env->textures.entry[index];
+    
+    if(p_entry->refCount == 0)
+    {
+      p_free = (p_free == NULL ? p_entry : p_free);
+      continue;
+    }
+    
+    if(strcmp(p_entry->file, p_texture->file) != 0)
+    {
+      continue;
+    }
+    
+    //asked for somewhere else, sharing would move it so it gets its own copy there
+    if((p_entry->vramVertex.vx != p_texture->vramVertex.vx) || (p_entry->vramVertex.vy != p_texture->vramVertex.vy))
+    {
+      printf("\nTEXTURE %s AT %d %d ALSO ASKED FOR AT %d %d, NOT SHARED\n", p_texture->file, p_entry->vramVertex.vx, p_entry->vramVertex.vy, p_texture->vramVertex.vx, p_texture->vramVertex.vy);
+      continue;
+    }
+    
+    p_entry->refCount++;
+    p_env->textures.shares++;
+    
+    p_texture->id = p_entry->id;
+    p_texture->dimensions = p_entry->dimensions;
+    
+    return 0;
+  }
+  
+  if(loadTexture(p_texture) < 0)
+  {
+    return -1;
+  }
+  
+  p_env->textures.loads++;
+  
+  //no room to track it (or a name too long for the key), it is still loaded but never shared
+  if((p_free == NULL) || (strlen(p_texture->file) >= sizeof(p_free->file)))
+  {
+    printf("\nTEXTURE NOT TRACKED\n");
+    return 0;
+  }
+  
+  strcpy(p_free->file, p_texture->file);
+  
+  p_free->id = p_texture->id;
+  p_free->vramVertex = p_texture->vramVertex;
+  p_free->dimensions = p_texture->dimensions;
+  p_free->refCount = 1;
+  
+  return 0;
+}
+
+//give back a texture acquireTexture handed out, its vram can be used for something else once nothing holds it
+void releaseTexture(struct s_environment *p_env, struct s_texture *p_texture)
+{
+  int index;
+  struct s_textureEntry *p_entry;
+  
+  for(index = 0; index < TEXTURE_CACHE_SIZE; index++)
+  {
+    p_entry = &p_env->textures.entry[index];
+    
+    if((p_entry->refCount > 0) && (strcmp(p_entry->file, p_texture->file) == 0) &&
+       (p_entry->vramVertex.vx == p_texture->vramVertex.vx) && (p_entry->vramVertex.vy == p_texture->vramVertex.vy))
+    {
+      p_entry->refCount--;
+      return;
+    }
+  }
+}
+
+//populate textures to VRAM
+int populateTextures(struct s_environment *p_env)
+{
+  int index;
+  int buffIndex;
+  
+  printf("\nStarted Getting texture info\n");
+  
+  //textures are bound into the packets, none to bind into without them
+  if(allocPrimitives(p_env) < 0)
+  {
+    return -1;
+  }
+  
+  //use texture info if it exists, each file is read, converted and uploaded once. objects already holding theirs keep it
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    if((p_env->p_primParam[index]->p_texture != NULL) && !(p_env->p_primParam[index]->flags & PRIM_FLAG_TEXTURE))
+    {
+      printf("\nTEXTURE AT INDEX %d %s\n", index, p_env->p_primParam[index]->p_texture->file);
+      
+      if(acquireTexture(p_env, p_env->p_primParam[index]->p_texture) == 0)
+      {
+	p_env->p_primParam[index]->flags |= PRIM_FLAG_TEXTURE;
+      }
+    }
+  }
+  
+  printf("\nTEXTURES LOADED %d SHARED %d\n", p_env->textures.loads, p_env->textures.shares);
+  
+  //update id info to primitives
+  for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
+  {
+    for(index = 0; index < p_env->primSize; index++)
+    {
+      if(p_env->p_primParam[index]->p_texture != NULL)
+      {
+	bindPrimTexture(&p_env->buffer[buffIndex].p_primitive[index], p_env->p_primParam[index]);
+      }
+    }
+  }
+  
+  return 0;
+}
+
+//load files from CD using high level library
+void *loadFileFromCD(char *p_path, uint32_t *op_len)
+{
+  int sizeSectors = 0;
+  int numRemain = 0;
+  int prevNumRemain = 0;
+  u_char result = 0;
+  
+  DslFILE fileInfo;
+  u_long *file = NULL;
+  
+  //search for file to get size
+  if(DsSearchFile(&fileInfo, p_path) <= 0)
+  {
+    printf("\nFILE SEARCH FAILED\n");
+    return NULL;
+  }
+
+  printf("\nFILE SEARCH SUCCESS\n");
+  
+  //read is in sectors, convert size to number of sectors
+  sizeSectors = (fileInfo.size + 2047) / 2048;
+
+  printf("\nSECTOR SIZE: %d %d", sizeSectors, fileInfo.size);
+  
+  file = malloc(sizeSectors * 2048);
+  
+  if(file == NULL)
+  {
+    printf("\nALLOCATION FAILED\n");
+    return NULL;
+  }
+  
+  printf("\nMEMORY ALLOCATED\n");
+  
+  //read, and keep reading till numRemain is 0
+  DsRead(&fileInfo.pos, sizeSectors, file, DslModeSpeed);
+  
+  do
+  {
+    numRemain = DsReadSync(&result);
+    
+    if(numRemain != prevNumRemain)
+    {
+      printf("\nNUM REMAIN: %d\n", numRemain);
+      prevNumRemain = numRemain;
+    }
+  }
+  while(numRemain);
+  
+  //return length if needed
+  if(op_len != NULL)
+  {
+    *op_len = fileInfo.size;
+  }
+  
+  printf("\nREAD COMPLETE\n");
+  
+  return file;
+}
+
+//get object data from xml files, a file already parsed is copied from its cached template without a CD read
+struct s_primParam *getObjects(char *fileName)
+{
+  int index;
+  char *p_buff = NULL;
+  struct s_primParam *p_primParam;
+  struct s_objectCacheEntry *p_entry;
+  
+  for(index = 0; index < OBJECT_CACHE_SIZE; index++)
+  {
+    p_entry = &g_objectCache.entry[index];
+    
+    if((p_entry->p_template != NULL) && (strcmp(p_entry->file, fileName) == 0))
+    {
+      g_objectCache.hits++;
+      
+      return copyObject(p_entry->p_template);
+    }
+  }
+  
+  g_objectCache.misses++;
+  
+  p_buff = (char *)loadFileFromCD(fileName, NULL);
+  
+  if(p_buff == NULL)
+  {
+    return NULL;
+  }
+  
+  setXMLdata(p_buff);
+  
+  p_primParam = getPrimData();
+  
+  resetGetPrimData();
+  
+  free(p_buff);
+  
+  //keep a copy as the template, names too long for the key are just not cached
+  if((p_primParam != NULL) && (strlen(fileName) < sizeof(p_entry->file)))
+  {
+    p_entry = &g_objectCache.entry[g_objectCache.next];
+    
+    freePrimData(&p_entry->p_template);
+    
+    p_entry->p_template = copyObject(p_primParam);
+    
+    strcpy(p_entry->file, fileName);
+    
+    g_objectCache.next = (g_objectCache.next + 1) % OBJECT_CACHE_SIZE;
+  }
+ 
+  return p_primParam;
+}
+
+//copy an object and its texture description, pixel data is not copied (templates never hold any)
+struct s_primParam *copyObject(struct s_primParam *p_primParam)
+{
+  struct s_primParam *p_copy;
+  
+  p_copy = malloc(sizeof(*p_copy));
+  
+  if(p_copy == NULL)
+  {
+    printf("\nBAD ALLOC\n");
+    return NULL;
+  }
+  
+  memcpy(p_copy, p_primParam, sizeof(*p_copy));
+  
+  //the texture reference stays with the original
+  p_copy->flags &= ~PRIM_FLAG_TEXTURE;
+  
+  if(p_primParam->p_texture != NULL)
+  {
+    p_copy->p_texture = malloc(sizeof(*p_copy->p_texture));
+    
+    if(p_copy->p_texture == NULL)
+    {
+      printf("\nBAD ALLOC\n");
+      free(p_copy);
+      return NULL;
+    }
+    
+    memcpy(p_copy->p_texture, p_primParam->p_texture, sizeof(*p_copy->p_texture));
+    
+    p_copy->p_texture->p_data = NULL;
+  }
+  
+  return p_copy;
+}
+
+//free every cached object template, the next getObjects of each file reads it from CD again (level changes)
+void flushObjects()
+{
+  int index;
+  
+  for(index = 0; index < OBJECT_CACHE_SIZE; index++)
+  {
+    freePrimData(&g_objectCache.entry[index].p_template);
+    
+    g_objectCache.entry[index].file[0] = 0;
+  }
+  
+  g_objectCache.next = 0;
+}
+
+//cache hits and misses of getObjects since the last call, both reset to 0
+void getObjectStats(int *op_hits, int *op_misses)
+{
+  if(op_hits != NULL)
+  {
+    *op_hits = g_objectCache.hits;
+  }
+  
+  if(op_misses != NULL)
+  {
+    *op_misses = g_objectCache.misses;
+  }
+  
+  g_objectCache.hits = 0;
+  g_objectCache.misses = 0;
+}
+
+//get many objects from one xml scene file, one CD read for the lot, fills p_primParam from start on
+int getScene(struct s_environment *p_env, char *fileName, int start)
+{
+  int count;
+  char *p_buff = NULL;
+  
+  if((start < 0) || (start >= p_env->primSize))
+  {
+    printf("\nSCENE START OUT OF RANGE\n");
+    return -1;
+  }
+  
+  p_buff = (char *)loadFileFromCD(fileName, NULL);
+  
+  if(p_buff == NULL)
+  {
+    return -1;
+  }
+  
+  setXMLdata(p_buff);
+  
+  count = getSceneData(&p_env->p_primParam[start], p_env->primSize - start);
+  
+  resetGetPrimData();
+  
+  free(p_buff);
+  
+  return count;
+}
+
+//get objects from a binary scene made by primc, records are copied into p_primParam from start without parsing
+int getSceneBin(struct s_environment *p_env, char *fileName, int start)
+{
+  int index;
+  int color;
+  int count;
+  uint32_t len = 0;
+  char const *p_strings;
+  uint8_t *p_buff = NULL;
+  struct s_primBinHeader *p_header;
+  struct s_primBinRecord *p_record;
+  struct s_primParam *p_primParam;
+  struct s_color *p_color[4];
+  
+  if((start < 0) || (start >= p_env->primSize))
+  {
+    printf("\nSCENE START OUT OF RANGE\n");
+    return -1;
+  }
+  
+  p_buff = (uint8_t *)loadFileFromCD(fileName, &len);
+  
+  if(p_buff == NULL)
+  {
+    return -1;
+  }
+  
+  p_header = (struct s_primBinHeader *)p_buff;
+  
+  if((len < sizeof(*p_header)) || (p_header->magic != PRIM_BIN_MAGIC) || (p_header->version != PRIM_BIN_VERSION) || (p_header->recordSize != sizeof(*p_record)))
+  {
+    printf("\nBAD SCENE BIN\n");
+    free(p_buff);
+    return -1;
+  }
+  
+  if(len < (sizeof(*p_header) + (p_header->count * sizeof(*p_record)) + p_header->stringSize))
+  {
+    printf("\nSCENE BIN TRUNCATED\n");
+    free(p_buff);
+    return -1;
+  }
+  
+  p_record = (struct s_primBinRecord *)(p_header + 1);
+  p_strings = (char const *)(p_record + p_header->count);
+  
+  count = (p_header->count < (p_env->primSize - start) ? p_header->count : (p_env->primSize - start));
+  
+  for(index = 0; index < count; index++, p_record++)
+  {
+    p_primParam = calloc(1, sizeof(*p_primParam));
+    
+    if(p_primParam == NULL)
+    {
+      printf("\nBAD ALLOC\n");
+      break;
+    }
+    
+    p_primParam->type = (p_record->type < TYPE_COUNT ? (enum en_primType)p_record->type : TYPE_F4);
+    
+    p_primParam->transCoor.vx = p_record->transX;
+    p_primParam->transCoor.vy = p_record->transY;
+    
+    p_primParam->dimensions.w = p_record->width;
+    p_primParam->dimensions.h = p_record->height;
+    
+    p_primParam->vertex0.vx = -(p_primParam->dimensions.w/2);
+    p_primParam->vertex0.vy = -(p_primParam->dimensions.h/2);
+    
+    p_color[0] = &p_primParam->color0;
+    p_color[1] = &p_primParam->color1;
+    p_color[2] = &p_primParam->color2;
+    p_color[3] = &p_primParam->color3;
+    
+    for(color = 0; color < 4; color++)
+    {
+      p_color[color]->r = p_record->color[color][0];
+      p_color[color]->g = p_record->color[color][1];
+      p_color[color]->b = p_record->color[color][2];
+    }
+    
+    if(p_record->flags & PRIM_BIN_TEXTURE)
+    {
+      p_primParam->p_texture = calloc(1, sizeof(*p_primParam->p_texture));
+      
+      if(p_primParam->p_texture == NULL)
+      {
+	printf("\nBAD ALLOC\n");
+	free(p_primParam);
+	break;
+      }
+      
+      p_primParam->p_texture->vertex0.vx = p_record->tvertexX;
+      p_primParam->p_texture->vertex0.vy = p_record->tvertexY;
+      p_primParam->p_texture->vramVertex.vx = p_record->vramX;
+      p_primParam->p_texture->vramVertex.vy = p_record->vramY;
+      p_primParam->p_texture->dimensions.w = p_record->twidth;
+      p_primParam->p_texture->dimensions.h = p_record->theight;
+      
+      if(p_record->fileOffset < p_header->stringSize)
+      {
+	strncpy(p_primParam->p_texture->file, p_strings + p_record->fileOffset, sizeof(p_primParam->p_texture->file) - 1);
+      }
+    }
+    
+    p_env->p_primParam[start + index] = p_primParam;
+  }
+  
+  free(p_buff);
+  
+  return index;
+}
+
+//clean up objects, the texture reference populateTextures took is given back first
+void freeObjects(struct s_environment *p_env, struct s_primParam **p_primParam)
+{
+  if((p_primParam != NULL) && (*p_primParam != NULL) && ((*p_primParam)->flags & PRIM_FLAG_TEXTURE))
+  {
+    releaseTexture(p_env, (*p_primParam)->p_texture);
+  }
+  
+  freePrimData(p_primParam);
+}
+
+//setup primitives for the ordering table, updatePrim links them into it every frame
+int populateOT(struct s_environment *p_env)
+{
+  int index;
+  int buffIndex;
+  struct s_primParam *p_primParam;
+  struct s_primTraits const *p_traits;
+  
+  //nothing is written or linked unless every object has its packets
+  if(allocPrimitives(p_env) < 0)
+  {
+    return -1;
+  }
+  
+  //packets are carved anew, chains of old static groups point at the previous ones
+  memset(p_env->staticGroup, 0, sizeof(p_env->staticGroup));
+  
+  if(p_env->background.members > 0)
+  {
+    removeBackground(p_env);
+  }
+  
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    p_primParam = p_env->p_primParam[index];
+    
+    if(p_primParam == NULL)
+    {
+      continue;
+    }
+    
+    p_primParam->flags &= ~(PRIM_FLAG_STATIC | PRIM_FLAG_LAYER);
+    
+    p_primParam->id = index;
+    
+    p_traits = getPrimTraits(p_primParam->type);
+    
+    if(p_traits == NULL)
+    {
+      printf("\nERROR, NO TYPE DEFINED AT INDEX %d\n", index);
+      continue;
+    }
+    
+    //update abstract primitive with psx parameters, local vertices are the corners with vertex0 top left
+    p_primParam->vertex0.vz = 1024;
+    
+    if(p_traits->numVertex == 4)
+    {
+      p_primParam->vertex1.vx = p_primParam->vertex0.vx + p_primParam->dimensions.w;
+      p_primParam->vertex1.vy = p_primParam->vertex0.vy;
+      p_primParam->vertex1.vz = 1024;
+      
+      p_primParam->vertex2.vx = p_primParam->vertex0.vx;
+      p_primParam->vertex2.vy = p_primParam->vertex0.vy + p_primParam->dimensions.h;
+      p_primParam->vertex2.vz = 1024;
+      
+      p_primParam->vertex3.vx = p_primParam->vertex0.vx + p_primParam->dimensions.w;
+      p_primParam->vertex3.vy = p_primParam->vertex0.vy + p_primParam->dimensions.h;
+      p_primParam->vertex3.vz = 1024;
+    }
+    
+    p_primParam->transCoor.vz = 0;
+    
+    p_primParam->scaleCoor.vx = ONE;
+    p_primParam->scaleCoor.vy = ONE;
+    p_primParam->scaleCoor.vz = ONE;
+    
+    for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
+    {
+      p_env->buffer[buffIndex].p_primitive[index].type = p_primParam->type;
+      
+      writePrimStatic(&p_env->buffer[buffIndex].p_primitive[index], p_primParam);
+    }
+    
+    transPrim(p_primParam, p_env);
+    
+    //static fields are written, every buffer still needs its geometry
+    markPrim(p_env, p_primParam, DIRTY_TRANS);
+    
+    placeGrid(p_env, p_primParam);
+  }
+  
+  sortBuckets(p_env);
+  
+  return 0;
+}
+
+//update native primitives for the play station via matrix math, only packets of the current buffer
+//that are marked dirty are touched, the rest still hold what was written when this buffer was last built.
+//the ordering table of the current buffer is cleared and every visible primitive is linked by its depth.
+void updatePrim(struct s_environment *p_env)
+{
+  int group;
+  int bufIndex;
+  long left;
+  long top;
+  long right;
+  long bottom;
+  long areaLeft;
+  long areaTop;
+  long areaRight;
+  long areaBottom;
+  u_short ofs[2];
+  RECT rect;
+  
+  //pipelined display, the gpu may still be reading this buffer's packets and table
+  PROF_BEGIN(PROF_GPU);
+  while(p_env->p_currBuffer->state == BUF_DRAWING);
+  PROF_END(PROF_GPU);
+  
+  PROF_BEGIN(PROF_UPDATE);
+  
+  p_env->primStats.drawn = 0;
+  p_env->primStats.culled = 0;
+  p_env->primStats.rotLoads = 0;
+  p_env->primStats.flat = 0;
+  p_env->primStats.statics = 0;
+  p_env->primStats.kept = 0;
+  
+  bufIndex = p_env->p_currBuffer - p_env->buffer;
+  
+  if(p_env->useDirtyRect)
+  {
+    buildDirtyRect(p_env);
+  }
+  else
+  {
+    p_env->p_currBuffer->full = 0;
+    p_env->p_currBuffer->partial = 0;
+    setRECT(&p_env->p_currBuffer->dirtyRect, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  }
+  
+  //draw area is the part being redrawn, the gpu keeps whole packets that reach outside it off the rest
+  setRECT(&p_env->p_currBuffer->draw.clip, gc_bufOrigin[bufIndex][0] + p_env->p_currBuffer->dirtyRect.x, gc_bufOrigin[bufIndex][1] + p_env->p_currBuffer->dirtyRect.y,
+	  p_env->p_currBuffer->dirtyRect.w, p_env->p_currBuffer->dirtyRect.h);
+  
+  ClearOTagR(p_env->p_currBuffer->p_ot, p_env->otSize);
+  
+  //restore the buffer's own offset last thing in the table so the font drawn after it is not shifted.
+  //first slot is drawn last and packets added first to a slot draw last, so add it before the batches.
+  if(p_env->cameraMode == CAMERA_OFFSET)
+  {
+    SetDrawOffset(&p_env->p_currBuffer->offset[1], (u_short *)p_env->p_currBuffer->draw.ofs);
+    AddPrim(p_env->p_currBuffer->p_ot, &p_env->p_currBuffer->offset[1]);
+  }
+  
+  PROF_CYCLES_BEGIN();
+  
+  if(p_env->noBatches)
+  {
+    updateUnbatched(p_env);
+  }
+  else
+  {
+    updateBatches(p_env);
+  }
+  
+  PROF_CYCLES_END(p_env->primStats.drawn + p_env->primStats.culled);
+  
+  //static groups go in whole with one link each, in front of their slot so they draw behind what shares it
+  for(group = 0; group < MAX_STATIC_GROUPS; group++)
+  {
+    if(p_env->staticGroup[group].members > 0)
+    {
+      AddPrims(&(p_env->p_currBuffer->p_ot[p_env->staticGroup[group].otIndex]), p_env->staticGroup[group].p_head[bufIndex], p_env->staticGroup[group].p_tail[bufIndex]);
+      
+      p_env->primStats.statics += p_env->staticGroup[group].members;
+    }
+  }
+  
+  PROF_STATIC(p_env->primStats.statics);
+  
+  //tiles go behind everything but the background layer
+  updateTilemap(p_env);
+  
+  //copy the area being redrawn out of the background layer ahead of everything, clear only what it does not cover
+  if(p_env->background.members > 0)
+  {
+    areaLeft = p_env->screenCoor.vx + p_env->p_currBuffer->dirtyRect.x;
+    areaTop = p_env->screenCoor.vy + p_env->p_currBuffer->dirtyRect.y;
+    areaRight = areaLeft + p_env->p_currBuffer->dirtyRect.w;
+    areaBottom = areaTop + p_env->p_currBuffer->dirtyRect.h;
+    
+    left = (areaLeft > p_env->background.worldCoor.vx ? areaLeft : p_env->background.worldCoor.vx);
+    top = (areaTop > p_env->background.worldCoor.vy ? areaTop : p_env->background.worldCoor.vy);
+    right = p_env->background.worldCoor.vx + p_env->background.vram.w;
+    right = (areaRight < right ? areaRight : right);
+    bottom = p_env->background.worldCoor.vy + p_env->background.vram.h;
+    bottom = (areaBottom < bottom ? areaBottom : bottom);
+    
+    if((right > left) && (bottom > top))
+    {
+      setRECT(&rect, p_env->background.vram.x + left - p_env->background.worldCoor.vx, p_env->background.vram.y + top - p_env->background.worldCoor.vy, right - left, bottom - top);
+      
+      SetDrawMove(&p_env->p_currBuffer->move, &rect, gc_bufOrigin[bufIndex][0] + left - p_env->screenCoor.vx, gc_bufOrigin[bufIndex][1] + top - p_env->screenCoor.vy);
+      AddPrim(p_env->p_currBuffer->p_ot + p_env->otSize - 1, &p_env->p_currBuffer->move);
+    }
+    
+    p_env->p_currBuffer->draw.isbg = !((left == areaLeft) && (top == areaTop) && (right == areaRight) && (bottom == areaBottom));
+  }
+  
+  //scroll the whole frame by the camera once, ahead of everything in the last slot (drawn first)
+  if(p_env->cameraMode == CAMERA_OFFSET)
+  {
+    ofs[0] = p_env->p_currBuffer->draw.ofs[0] - p_env->screenCoor.vx;
+    ofs[1] = p_env->p_currBuffer->draw.ofs[1] - p_env->screenCoor.vy;
+    
+    SetDrawOffset(&p_env->p_currBuffer->offset[0], ofs);
+    AddPrim(p_env->p_currBuffer->p_ot + p_env->otSize - 1, &p_env->p_currBuffer->offset[0]);
+  }
+  
+  PROF_END(PROF_UPDATE);
+}
+
+//work out the real coordinates and matrix of a primitive, marks it dirty and returns 1 if anything changed
+int placePrim(struct s_environment *p_env, struct s_primParam *p_primParam)
+{
+  struct s_lvertex realCoor;
+  
+  realCoor.vx = p_primParam->transCoor.vx - p_primParam->vertex0.vx;
+  realCoor.vy = p_primParam->transCoor.vy - p_primParam->vertex0.vy;
+  
+  //in offset mode the camera is applied by updatePrim, world coordinates stay put while it scrolls
+  if(p_env->cameraMode == CAMERA_TRANSFORM)
+  {
+    realCoor.vx -= p_env->screenCoor.vx;
+    realCoor.vy -= p_env->screenCoor.vy;
+  }
+  
+  realCoor.vz = p_primParam->transCoor.vz;
+  realCoor.pad = p_primParam->realCoor.pad;
+  
+  if((memcmp(&realCoor, &p_primParam->realCoor, sizeof(realCoor)) == 0) &&
+     (memcmp(&p_primParam->rotCoor, &p_primParam->prevRotCoor, sizeof(p_primParam->rotCoor)) == 0) &&
+     (memcmp(&p_primParam->scaleCoor, &p_primParam->prevScaleCoor, sizeof(p_primParam->scaleCoor)) == 0))
+  {
+    return 0;
+  }
+  
+  p_primParam->realCoor = realCoor;
+  
+  //unrotated and unscaled on the z = 0 plane needs no matrix, updatePrim places it with adds
+  if((p_primParam->flags & PRIM_FLAG_FORCE_2D) ||
+     ((p_primParam->rotCoor.vx == 0) && (p_primParam->rotCoor.vy == 0) && (p_primParam->rotCoor.vz == 0) &&
+      (p_primParam->scaleCoor.vx == ONE) && (p_primParam->scaleCoor.vy == ONE) && (p_primParam->scaleCoor.vz == ONE) &&
+      (p_primParam->transCoor.vz == 0)))
+  {
+    p_primParam->prevRotCoor = p_primParam->rotCoor;
+    p_primParam->prevScaleCoor = p_primParam->scaleCoor;
+    p_primParam->flags |= PRIM_FLAG_2D;
+  }
+  else
+  {
+    buildMatrix(p_env, p_primParam);
+    p_primParam->flags &= ~PRIM_FLAG_2D;
+  }
+  
+  markPrim(p_env, p_primParam, DIRTY_TRANS);
+  
+  return 1;
+}
+
+//use the abstract primitive to generate its native sister primitives updated coordinates.
+//if nothing changed since the last call, or it is out of view, the matrix is kept and no packet is marked.
+void transPrim(struct s_primParam *p_primParam, struct s_environment *p_env)
+{
+  //members of static groups and the background layer were placed once when they were linked or composed
+  if(p_primParam->flags & (PRIM_FLAG_STATIC | PRIM_FLAG_LAYER))
+  {
+    return;
+  }
+  
+  //out of view or not, queries have to find it where it is
+  placeGrid(p_env, p_primParam);
+  
+  PROF_BEGIN(PROF_TRANS);
+  
+  //no gte work for what can not be seen, updatePrim calls back in once it is in view
+  if(!isPrimVisible(p_env, p_primParam))
+  {
+    p_primParam->flags |= PRIM_FLAG_CULLED;
+    PROF_END(PROF_TRANS);
+    return;
+  }
+  
+  p_primParam->flags &= ~PRIM_FLAG_CULLED;
+  
+  placePrim(p_env, p_primParam);
+  
+  PROF_END(PROF_TRANS);
+}
+
+//switch between waiting for draw and vsync in display, or kicking the draw and flipping from callbacks
+void setFrameMode(struct s_environment *p_env, enum en_frameMode mode)
+{
+  //let the gpu finish what it has before the callbacks change
+  DrawSync(0);
+  
+  readyBuffers(p_env);
+  
+  p_env->frameMode = mode;
+  
+  DrawSyncCallback(mode == FRAME_PIPELINED ? drawDone : NULL);
+}
+
+//register an update job to run every rate ticks (1 is every tick), returns its index or -1 if the table is full
+int addJob(struct s_environment *p_env, void (*p_update)(struct s_environment *p_env), int rate)
+{
+  if(p_env->sched.jobCount >= MAX_JOBS)
+  {
+    printf("\nJOB TABLE FULL\n");
+    return -1;
+  }
+  
+  p_env->sched.job[p_env->sched.jobCount].p_update = p_update;
+  p_env->sched.job[p_env->sched.jobCount].rate = (rate < 1 ? 1 : rate);
+  
+  return p_env->sched.jobCount++;
+}
+
+//run jobs once for every tick since the last call, in tick order, at most MAX_CATCHUP ticks a frame
+void runJobs(struct s_environment *p_env)
+{
+  int index;
+  uint32_t now;
+  
+  now = p_env->sched.vsyncTicks;
+  
+  //too far behind, drop the oldest ticks instead of stalling on them
+  if((now - p_env->sched.tick) > MAX_CATCHUP)
+  {
+    p_env->sched.tick = now - MAX_CATCHUP;
+  }
+  
+  while(p_env->sched.tick != now)
+  {
+    p_env->sched.tick++;
+    
+    for(index = 0; index < p_env->sched.jobCount; index++)
+    {
+      if((p_env->sched.tick % p_env->sched.job[index].rate) == 0)
+      {
+	p_env->sched.job[index].p_update(p_env);
+      }
+    }
+  }
+}
+
+//true if rate ticks have passed since op_prevTick (or it was never set), and sets it to the current tick
+int checkRate(struct s_environment *p_env, int *op_prevTick, int rate)
+{
+  if((*op_prevTick != 0) && (((int)p_env->sched.tick - *op_prevTick) < rate))
+  {
+    return 0;
+  }
+  
+  *op_prevTick = p_env->sched.tick;
+  
+  return 1;
+}
+
+//flag parts of a primitive as changed for every buffer, each buffer clears its own flags when updatePrim rebuilds it
+void markPrim(struct s_environment *p_env, struct s_primParam *p_primParam, uint8_t flags)
+{
+  int bufIndex;
+  
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+  {
+    p_primParam->dirty[bufIndex] |= flags;
+  }
+}
+
+//carve a ring of sprites per buffer for the tiles in view and set the ones that never change
+int setTilemap(struct s_environment *p_env, uint8_t *p_tiles, int width, int height, int tileSize, struct s_texture *p_texture)
+{
+  int index;
+  int bufIndex;
+  int ringSize;
+  struct s_tilemap *p_tilemap;
+  
+  p_tilemap = &p_env->tilemap;
+  
+  if((p_tiles == NULL) || (p_texture == NULL) || (width < 1) || (height < 1) || ((tileSize != 8) && (tileSize != 16)))
+  {
+    printf("\nBAD TILEMAP\n");
+    return -1;
+  }
+  
+  if(p_texture->dimensions.w < (uint32_t)tileSize)
+  {
+    printf("\nTILE TEXTURE NARROWER THAN A TILE\n");
+    return -1;
+  }
+  
+  //a tile more than fits each way, the screen seldom lines up with the grid
+  ringSize = ((SCREEN_WIDTH / tileSize) + 1) * ((SCREEN_HEIGHT / tileSize) + 1);
+  
+  //keep the ring from the last map if it is big enough
+  if((p_tilemap->p_ring[0] == NULL) || (p_tilemap->ringSize < ringSize))
+  {
+    for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+    {
+      p_tilemap->p_ring[bufIndex] = allocArena(p_env, ringSize * sizeof(SPRT_16));
+      p_tilemap->p_tpage[bufIndex] = allocArena(p_env, sizeof(DR_TPAGE));
+      
+      if((p_tilemap->p_ring[bufIndex] == NULL) || (p_tilemap->p_tpage[bufIndex] == NULL))
+      {
+	printf("\nNO ARENA FOR TILEMAP\n");
+	memset(p_tilemap, 0, sizeof(*p_tilemap));
+	return -1;
+      }
+    }
+    
+    p_tilemap->ringSize = ringSize;
+  }
+  
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+  {
+    for(index = 0; index < p_tilemap->ringSize; index++)
+    {
+      if(tileSize == 16)
+      {
+	setSprt16(&p_tilemap->p_ring[bufIndex][index]);
+      }
+      else
+      {
+	setSprt8((SPRT_8 *)&p_tilemap->p_ring[bufIndex][index]);
+      }
+      
+      setRGB0(&p_tilemap->p_ring[bufIndex][index], 128, 128, 128);
+    }
+    
+    SetDrawTPage(p_tilemap->p_tpage[bufIndex], 1, 0, p_texture->id);
+  }
+  
+  p_tilemap->p_tiles = p_tiles;
+  p_tilemap->width = width;
+  p_tilemap->height = height;
+  p_tilemap->tileSize = tileSize;
+  p_tilemap->tilesPerRow = p_texture->dimensions.w / tileSize;
+  p_tilemap->p_texture = p_texture;
+  
+  //what the buffers hold no longer matches, dirty rect mode redraws them whole
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+  {
+    p_env->buffer[bufIndex].full = 0;
+  }
+  
+  return 0;
+}
+
+//write the packets of a run of primitives into every buffer and link them into one chain per buffer, deepest first
+int addStaticGroup(struct s_environment *p_env, int start, int count)
+{
+  int group;
+  int index;
+  int member;
+  int members;
+  int prev;
+  int bufIndex;
+  int otIndex;
+  int *p_order;
+  void *p_prev;
+  struct s_primitive *p_primitive;
+  struct s_primParam *p_primParam;
+  struct s_staticGroup *p_group;
+  
+  if((start < 0) || (count < 1) || ((start + count) > p_env->primSize))
+  {
+    printf("\nSTATIC GROUP %d TO %d OUT OF RANGE\n", start, start + count - 1);
+    return -1;
+  }
+  
+  //packets are written once, with CAMERA_TRANSFORM the camera is in their coordinates and they would not scroll
+  if(p_env->cameraMode != CAMERA_OFFSET)
+  {
+    printf("\nSTATIC GROUPS NEED CAMERA_OFFSET\n");
+    return -1;
+  }
+  
+  for(group = 0; (group < MAX_STATIC_GROUPS) && (p_env->staticGroup[group].members > 0); group++);
+  
+  if(group == MAX_STATIC_GROUPS)
+  {
+    printf("\nNO FREE STATIC GROUP\n");
+    return -1;
+  }
+  
+  p_order = malloc(count * sizeof(int));
+  
+  if(p_order == NULL)
+  {
+    printf("\nSTATIC GROUP ALLOCATION FAILED\n");
+    return -1;
+  }
+  
+  members = 0;
+  
+  for(index = start; index < (start + count); index++)
+  {
+    p_primParam = p_env->p_primParam[index];
+    
+    if((p_primParam == NULL) || (p_env->buffer[0].p_primitive[index].data == NULL))
+    {
+      continue;
+    }
+    
+    if(p_primParam->flags & PRIM_FLAG_STATIC)
+    {
+      printf("\nPRIMITIVE %d IS ALREADY STATIC\n", index);
+      free(p_order);
+      return -1;
+    }
+    
+    p_order[members++] = index;
+  }
+  
+  if(members == 0)
+  {
+    printf("\nSTATIC GROUP %d TO %d HAS NO PRIMITIVES\n", start, start + count - 1);
+    free(p_order);
+    return -1;
+  }
+  
+  //the whole group is drawn every frame, so none of it is culled. write every buffer now, updatePrim never will.
+  for(member = 0; member < members; member++)
+  {
+    p_primParam = p_env->p_primParam[p_order[member]];
+    
+    p_primParam->flags &= ~PRIM_FLAG_CULLED;
+    p_primParam->flags |= PRIM_FLAG_STATIC;
+    
+    placePrim(p_env, p_primParam);
+    
+    for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+    {
+      p_primParam->otz = writePrimAll(p_env, &p_env->buffer[bufIndex].p_primitive[p_order[member]], p_primParam);
+      p_primParam->dirty[bufIndex] = 0;
+    }
+  }
+  
+  //insertion sort, deepest slot first and index order within a slot, the way the table would draw them
+  for(member = 1; member < members; member++)
+  {
+    index = p_order[member];
+    otIndex = getOTindex(p_env, p_env->p_primParam[index]);
+    
+    for(prev = member - 1; (prev >= 0) && (getOTindex(p_env, p_env->p_primParam[p_order[prev]]) < otIndex); prev--)
+    {
+      p_order[prev + 1] = p_order[prev];
+    }
+    
+    p_order[prev + 1] = index;
+  }
+  
+  p_group = &p_env->staticGroup[group];
+  
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+  {
+    p_prev = NULL;
+    
+    for(member = 0; member < members; member++)
+    {
+      p_primitive = &p_env->buffer[bufIndex].p_primitive[p_order[member]];
+      
+      //texture page has to be drawn before the sprite that uses it
+      if(p_primitive->p_tpage != NULL)
+      {
+	catPrim(p_primitive->p_tpage, p_primitive->data);
+      }
+      
+      if(p_prev == NULL)
+      {
+	p_group->p_head[bufIndex] = (p_primitive->p_tpage != NULL ? p_primitive->p_tpage : p_primitive->data);
+      }
+      else
+      {
+	catPrim(p_prev, (p_primitive->p_tpage != NULL ? p_primitive->p_tpage : p_primitive->data));
+      }
+      
+      p_prev = p_primitive->data;
+    }
+    
+    p_group->p_tail[bufIndex] = p_prev;
+  }
+  
+  p_group->start = start;
+  p_group->count = count;
+  p_group->otIndex = getOTindex(p_env, p_env->p_primParam[p_order[0]]);
+  p_group->members = members;
+  
+  free(p_order);
+  
+  sortBuckets(p_env);
+  
+  return group;
+}
+
+//hand the members of a static group back to updatePrim
+void removeStaticGroup(struct s_environment *p_env, int group)
+{
+  int index;
+  struct s_staticGroup *p_group;
+  
+  if((group < 0) || (group >= MAX_STATIC_GROUPS) || (p_env->staticGroup[group].members == 0))
+  {
+    printf("\nNO STATIC GROUP %d\n", group);
+    return;
+  }
+  
+  p_group = &p_env->staticGroup[group];
+  
+  for(index = p_group->start; index < (p_group->start + p_group->count); index++)
+  {
+    if(p_env->p_primParam[index] != NULL)
+    {
+      p_env->p_primParam[index]->flags &= ~PRIM_FLAG_STATIC;
+      markPrim(p_env, p_env->p_primParam[index], DIRTY_ALL);
+    }
+  }
+  
+  memset(p_group, 0, sizeof(*p_group));
+  
+  sortBuckets(p_env);
+}
+
+//primitives the last updatePrim linked through static groups, each one a cull, transform, write and link saved
+int getStaticSaved(struct s_environment *p_env)
+{
+  return p_env->primStats.statics;
+}
+
+//draw a run of primitives once into a layer off screen, from then on updatePrim copies the view out of it
+int addBackground(struct s_environment *p_env, int start, int count, int vramX, int vramY)
+{
+  int index;
+  int bufIndex;
+  int members;
+  long minX;
+  long minY;
+  long maxX;
+  long maxY;
+  unsigned long ot;
+  DRAWENV draw;
+  struct s_primitive *p_primitive;
+  struct s_primParam *p_primParam;
+  
+  if(p_env->background.members > 0)
+  {
+    printf("\nBACKGROUND LAYER ALREADY SET\n");
+    return -1;
+  }
+  
+  if((start < 0) || (count < 1) || ((start + count) > p_env->primSize))
+  {
+    printf("\nBACKGROUND %d TO %d OUT OF RANGE\n", start, start + count - 1);
+    return -1;
+  }
+  
+  members = 0;
+  minX = minY = 0x7FFFFFFF;
+  maxX = maxY = -0x7FFFFFFF;
+  
+  //world box around the members is the size of the layer
+  for(index = start; index < (start + count); index++)
+  {
+    p_primParam = p_env->p_primParam[index];
+    
+    if((p_primParam == NULL) || (p_env->buffer[0].p_primitive[index].data == NULL))
+    {
+      continue;
+    }
+    
+    if(p_primParam->flags & PRIM_FLAG_STATIC)
+    {
+      printf("\nPRIMITIVE %d IS STATIC\n", index);
+      return -1;
+    }
+    
+    minX = (p_primParam->transCoor.vx < minX ? p_primParam->transCoor.vx : minX);
+    minY = (p_primParam->transCoor.vy < minY ? p_primParam->transCoor.vy : minY);
+    maxX = ((p_primParam->transCoor.vx + (long)p_primParam->dimensions.w) > maxX ? (p_primParam->transCoor.vx + (long)p_primParam->dimensions.w) : maxX);
+    maxY = ((p_primParam->transCoor.vy + (long)p_primParam->dimensions.h) > maxY ? (p_primParam->transCoor.vy + (long)p_primParam->dimensions.h) : maxY);
+    
+    members++;
+  }
+  
+  if(members == 0)
+  {
+    printf("\nBACKGROUND %d TO %d HAS NO PRIMITIVES\n", start, start + count - 1);
+    return -1;
+  }
+  
+  if((vramX < 0) || (vramY < 0) || ((vramX + maxX - minX) > 1024) || ((vramY + maxY - minY) > 512))
+  {
+    printf("\nBACKGROUND %ldX%ld DOES NOT FIT IN VRAM AT %d %d\n", maxX - minX, maxY - minY, vramX, vramY);
+    return -1;
+  }
+  
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
+  {
+    if((vramX < (gc_bufOrigin[bufIndex][0] + SCREEN_WIDTH)) && ((vramX + maxX - minX) > gc_bufOrigin[bufIndex][0]) &&
+       (vramY < (gc_bufOrigin[bufIndex][1] + SCREEN_HEIGHT)) && ((vramY + maxY - minY) > gc_bufOrigin[bufIndex][1]))
+    {
+      printf("\nBACKGROUND OVERLAPS DISPLAY BUFFER %d\n", bufIndex);
+      return -1;
+    }
+  }
+  
+  //nothing else may be drawing while the layer is composed
+  DrawSync(0);
+  
+  ClearOTagR(&ot, 1);
+  
+  //backwards, AddPrim puts each packet in front so the members draw in index order
+  for(index = (start + count - 1); index >= start; index--)
   {
-    printf("\nNo CD Track Playing\n");
+    p_primParam = p_env->p_primParam[index];
+    
+    if((p_primParam == NULL) || (p_env->buffer[0].p_primitive[index].data == NULL))
+    {
+      continue;
+    }
+    
+    p_primParam->flags &= ~PRIM_FLAG_CULLED;
+    p_primParam->flags |= PRIM_FLAG_LAYER;
+    
+    placePrim(p_env, p_primParam);
+    
+    p_primitive = &p_env->buffer[0].p_primitive[index];
+    
+    writePrimAll(p_env, p_primitive, p_primParam);
+    
+    AddPrim(&ot, p_primitive->data);
+    
+    if(p_primitive->p_tpage != NULL)
+    {
+      AddPrim(&ot, p_primitive->p_tpage);
+    }
   }
   
-  printf("\nCurrent Track: %d\n", DsPlay(3, p_tracks, 1));
-}
-
-//update display
-void display(struct s_environment *p_env)
-{
-  //avoid issues with delayed execution
-  while(DrawSync(1));
-  VSync(0);
-  //font flush now so contents get drawn
-  FntFlush(-1);
+  //offset takes world coordinates to the layer, transform mode has already taken the camera off them
+  SetDefDrawEnv(&draw, vramX, vramY, maxX - minX, maxY - minY);
   
-  //put the current buffer contents up
-  PutDrawEnv(&p_env->p_currBuffer->draw);
-  PutDispEnv(&p_env->p_currBuffer->disp);
+  draw.ofs[0] = vramX - minX + (p_env->cameraMode == CAMERA_TRANSFORM ? p_env->screenCoor.vx : 0);
+  draw.ofs[1] = vramY - minY + (p_env->cameraMode == CAMERA_TRANSFORM ? p_env->screenCoor.vy : 0);
+  draw.isbg = 1;
+  draw.r0 = p_env->buffer[0].draw.r0;
+  draw.g0 = p_env->buffer[0].draw.g0;
+  draw.b0 = p_env->buffer[0].draw.b0;
   
-  //start drawings
-  DrawOTag(p_env->p_currBuffer->p_ot);
+  PutDrawEnv(&draw);
+  DrawOTag(&ot);
+  DrawSync(0);
   
-  //exchange reg and draw buffer, so newly registered ot will be drawn, and used draw buffer can now be used for registration.
-  swapBuffers(p_env);
+  setRECT(&p_env->background.vram, vramX, vramY, maxX - minX, maxY - minY);
   
-  //write header before all other font prints
-  FntPrint("%s\n%s\n%X", p_env->envMessage.p_title, p_env->envMessage.p_message, *p_env->envMessage.p_data);
+  p_env->background.worldCoor.vx = minX;
+  p_env->background.worldCoor.vy = minY;
+  p_env->background.start = start;
+  p_env->background.count = count;
+  p_env->background.members = members;
+  
+  sortBuckets(p_env);
+  
+  return 0;
 }
 
-//populate textures to VRAM
-void populateTextures(struct s_environment *p_env)
+//drop the background layer, buffers are cleared again and the members are rewritten by updatePrim
+void removeBackground(struct s_environment *p_env)
 {
   int index;
-  int buffIndex;
-  int returnValue = 0;
-  
-  printf("\nStarted Getting texture info\n");
+  int bufIndex;
   
-  //use texture info if it exists
-  for(index = 0; index < p_env->otSize; index++)
+  for(index = p_env->background.start; index < (p_env->background.start + p_env->background.count); index++)
   {
-    if(p_env->p_primParam[index]->p_texture != NULL)
+    if(p_env->p_primParam[index] != NULL)
     {
-      printf("\nTEXTURE AT INDEX %d %s\n", index, p_env->p_primParam[index]->p_texture->file);
-      
-      //load texture file from CD
-      p_env->p_primParam[index]->p_texture->p_data = (uint8_t *)loadFileFromCD(p_env->p_primParam[index]->p_texture->file, &(p_env->p_primParam[index]->p_texture->size));
-      
-      if(p_env->p_primParam[index]->p_texture->p_data != NULL)
-      {
-	printf("\nGETTING RAW\n");
-	
-	//convert bitmaps to raw data
-	returnValue = bitmapToRAW(&(p_env->p_primParam[index]->p_texture->p_data), p_env->p_primParam[index]->p_texture->size, p_env->p_primParam[index]->p_texture->dimensions.w, p_env->p_primParam[index]->p_texture->dimensions.h);
-	
-	if(returnValue > 0)
-	{
-	  p_env->p_primParam[index]->p_texture->size = returnValue;
-	}
-	else if(returnValue < 0)
-	{
-	  printf("\nBAD DATA\n");
-	  continue;
-	}
-	
-	//convert color space
-	if(swapRedBlue(p_env->p_primParam[index]->p_texture->p_data, p_env->p_primParam[index]->p_texture->size) < 0)
-	{
-	  printf("\nSWAP FAILED\n");
-	  continue;
-	}
-	
-	//load via LoadTPage (can also be done with loadImage, and some checking that transfer is over, then use getIDtpage.
-	p_env->p_primParam[index]->p_texture->id = LoadTPage((u_long *)p_env->p_primParam[index]->p_texture->p_data, 2, 0, p_env->p_primParam[index]->p_texture->vramVertex.vx, p_env->p_primParam[index]->p_texture->vramVertex.vy, p_env->p_primParam[index]->p_texture->dimensions.w, p_env->p_primParam[index]->p_texture->dimensions.h);
-
-	//wait for transfer to finish
-	while(DrawSync(1));
-	
-	//data transfered, free some memory
-	free(p_env->p_primParam[index]->p_texture->p_data);
-	p_env->p_primParam[index]->p_texture->p_data = NULL;
-      }
+      p_env->p_primParam[index]->flags &= ~PRIM_FLAG_LAYER;
+      markPrim(p_env, p_env->p_primParam[index], DIRTY_ALL);
     }
   }
   
-  //update id info to primitives
-  for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
+  for(bufIndex = 0; bufIndex < p_env->bufSize; bufIndex++)
   {
-    for(index = 0; index < p_env->otSize; index++)
-    {
-      if(p_env->p_primParam[index]->p_texture != NULL)
-      {
-	p_env->buffer[buffIndex].p_primitive[index].type = p_env->p_primParam[index]->type;
-	
-	switch(p_env->buffer[buffIndex].p_primitive[index].type)
-	{
-	  case TYPE_FT4:
-	    printf("\nTYPE_FT4\n");
-	    ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->tpage = p_env->p_primParam[index]->p_texture->id;
-	    printf("\nID %d CLUT %d\n", ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->tpage, ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->clut);
-	    break;
-	  case TYPE_GT4:
-	    ((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->tpage = p_env->p_primParam[index]->p_texture->id;
-	    break;
-	  case TYPE_SPRITE:
-	    printf("\nTYPE_SPRITE\n");
-	    SetDrawTPage((DR_TPAGE *)(&p_env->p_primParam[index]->p_texture->tpage), 1, 0, p_env->p_primParam[index]->p_texture->id);
-	    AddPrim(&(p_env->buffer[buffIndex].p_ot[index]), &p_env->p_primParam[index]->p_texture->tpage);
-	    break;
-	  default:
-	    printf("\nNon Texture Type at index %d\n", index);
-	    break;
-	}
-      }
-    }
+    p_env->buffer[bufIndex].draw.isbg = 1;
   }
-}
-
-//load files from CD using high level library
-void *loadFileFromCD(char *p_path, uint32_t *op_len)
-{
-  int sizeSectors = 0;
-  int numRemain = 0;
-  int prevNumRemain = 0;
-  u_char result = 0;
-  
-  DslFILE fileInfo;
-  u_long *file = NULL;
   
-  //search for file to get size
-  if(DsSearchFile(&fileInfo, p_path) <= 0)
-  {
-    printf("\nFILE SEARCH FAILED\n");
-    return NULL;
-  }
-
-  printf("\nFILE SEARCH SUCCESS\n");
+  memset(&p_env->background, 0, sizeof(p_env->background));
   
-  //read is in sectors, convert size to number of sectors
-  sizeSectors = (fileInfo.size + 2047) / 2048;
+  sortBuckets(p_env);
+}
 
-  printf("\nSECTOR SIZE: %d %d", sizeSectors, fileInfo.size);
-  
-  file = malloc(sizeSectors * 2048);
-  
-  if(file == NULL)
+//move a primitive to the grid cell under the center of its box, nothing to do while it stays in the same cell
+void placeGrid(struct s_environment *p_env, struct s_primParam *p_primParam)
+{
+  int hasBox;
+  int bucket;
+  long box[4];
+  int16_t cellX = 0;
+  int16_t cellY = 0;
+  struct s_gridNode *p_node;
+  
+  if((p_env->grid.p_node == NULL) || (p_primParam->id < 0) || (p_primParam->id >= p_env->primSize))
   {
-    printf("\nALLOCATION FAILED\n");
-    return NULL;
+    return;
   }
   
-  printf("\nMEMORY ALLOCATED\n");
+  p_node = &p_env->grid.p_node[p_primParam->id];
   
-  //read, and keep reading till numRemain is 0
-  DsRead(&fileInfo.pos, sizeSectors, file, DslModeSpeed);
+  //primitives off the z = 0 plane have no box and are left out
+  hasBox = getPrimBox(p_primParam, box);
   
-  do
+  if(hasBox)
   {
-    numRemain = DsReadSync(&result);
+    cellX = ((box[0] + box[2]) / 2) >> GRID_CELL_SHIFT;
+    cellY = ((box[1] + box[3]) / 2) >> GRID_CELL_SHIFT;
     
-    if(numRemain != prevNumRemain)
+    p_env->grid.maxExtent = ((box[2] - box[0]) > p_env->grid.maxExtent ? (box[2] - box[0]) : p_env->grid.maxExtent);
+    p_env->grid.maxExtent = ((box[3] - box[1]) > p_env->grid.maxExtent ? (box[3] - box[1]) : p_env->grid.maxExtent);
+    
+    if(p_node->linked && (p_node->cellX == cellX) && (p_node->cellY == cellY))
     {
-      printf("\nNUM REMAIN: %d\n", numRemain);
-      prevNumRemain = numRemain;
+      return;
     }
   }
-  while(numRemain);
   
-  //return length if needed
-  if(op_len != NULL)
+  leaveGrid(p_env, p_primParam);
+  
+  if(!hasBox)
   {
-    *op_len = fileInfo.size;
+    return;
   }
   
-  printf("\nREAD COMPLETE\n");
+  bucket = GRID_BUCKET(cellX, cellY);
   
-  return file;
+  p_node->cellX = cellX;
+  p_node->cellY = cellY;
+  p_node->prev = -1;
+  p_node->next = p_env->grid.head[bucket];
+  p_node->linked = 1;
+  
+  if(p_node->next >= 0)
+  {
+    p_env->grid.p_node[p_node->next].prev = p_primParam->id;
+  }
+  
+  p_env->grid.head[bucket] = p_primParam->id;
 }
 
-//get object data from xml files
-struct s_primParam *getObjects(char *fileName)
+//unlink a primitive from its cell's bucket
+void leaveGrid(struct s_environment *p_env, struct s_primParam *p_primParam)
 {
-  char *p_buff = NULL;
-  struct s_primParam *p_primParam;
-  
-  p_buff = (char *)loadFileFromCD(fileName, NULL);
+  struct s_gridNode *p_node;
   
-  if(p_buff == NULL)
+  if((p_env->grid.p_node == NULL) || (p_primParam->id < 0) || (p_primParam->id >= p_env->primSize))
   {
-    return NULL;
+    return;
   }
   
-  setXMLdata(p_buff);
+  p_node = &p_env->grid.p_node[p_primParam->id];
   
-  p_primParam = getPrimData();
+  if(!p_node->linked)
+  {
+    return;
+  }
   
-  resetGetPrimData();
+  if(p_node->prev < 0)
+  {
+    p_env->grid.head[GRID_BUCKET(p_node->cellX, p_node->cellY)] = p_node->next;
+  }
+  else
+  {
+    p_env->grid.p_node[p_node->prev].next = p_node->next;
+  }
   
-  free(p_buff);
- 
-  return p_primParam;
-}
-
-//clean up objects
-void freeObjects(struct s_primParam **p_primParam)
-{
-  freePrimData(p_primParam);
+  if(p_node->next >= 0)
+  {
+    p_env->grid.p_node[p_node->next].prev = p_node->prev;
+  }
+  
+  p_node->linked = 0;
 }
 
-//setup primitives for ordering table and add them
-void populateOT(struct s_environment *p_env)
+//walk the cells the area could reach, a primitive is only listed in the one cell it sits in so none come up twice
+int queryBox(struct s_environment *p_env, long left, long top, long right, long bottom, int *op_index, int maxCount)
 {
   int index;
-  int buffIndex;
-  
-  for(index = 0; index < p_env->otSize; index++)
-  {    
-    for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
+  int count;
+  long reach;
+  long box[4];
+  int16_t cellX;
+  int16_t cellY;
+  int16_t firstX;
+  int16_t firstY;
+  int16_t lastX;
+  int16_t lastY;
+  struct s_gridNode *p_node;
+  
+  count = 0;
+  
+  //boxes are listed by their center, reach out by half the largest one
+  reach = (p_env->grid.maxExtent / 2) + 1;
+  
+  firstX = (left - reach) >> GRID_CELL_SHIFT;
+  firstY = (top - reach) >> GRID_CELL_SHIFT;
+  lastX = (right + reach) >> GRID_CELL_SHIFT;
+  lastY = (bottom + reach) >> GRID_CELL_SHIFT;
+  
+  for(cellY = firstY; cellY <= lastY; cellY++)
+  {
+    for(cellX = firstX; cellX <= lastX; cellX++)
     {
-      p_env->buffer[buffIndex].p_primitive[index].type = p_env->p_primParam[index]->type;
-      
-      switch(p_env->buffer[buffIndex].p_primitive[index].type)
+      for(index = p_env->grid.head[GRID_BUCKET(cellX, cellY)]; index >= 0; index = p_node->next)
       {
-	case TYPE_SPRITE:
-	  SetSprt((SPRT *)p_env->buffer[buffIndex].p_primitive[index].data);
-	  setXY0((SPRT *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->vertex0.vx, p_env->p_primParam[index]->vertex0.vy);
-	  setWH((SPRT *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->dimensions.w,  p_env->p_primParam[index]->dimensions.h);
-	  setUV0((SPRT *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->p_texture->vertex0.vx, p_env->p_primParam[index]->p_texture->vertex0.vy);
-	  setRGB0((SPRT *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	  	  
-	  //update abstract primitive with psx parameters created at its creation
-	  p_env->p_primParam[index]->vertex0.vz = 1024;
-	  
-	  p_env->p_primParam[index]->transCoor.vz = 0;
-	  
-	  p_env->p_primParam[index]->scaleCoor.vx = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vy = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vz = ONE;
-	  break;
-	case TYPE_TILE:
-	  setTile((TILE *)p_env->buffer[buffIndex].p_primitive[index].data);
-	  setXY0((TILE *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->vertex0.vx, p_env->p_primParam[index]->vertex0.vy);
-	  setWH((TILE *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->dimensions.w,  p_env->p_primParam[index]->dimensions.h);
-	  setRGB0((TILE *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	  
-	  //update abstract primitive with psx parameters created at its creation
-	  p_env->p_primParam[index]->vertex0.vz = 1024;
-	  
-	  p_env->p_primParam[index]->transCoor.vz = 0;
-	  
-	  p_env->p_primParam[index]->scaleCoor.vx = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vy = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vz = ONE;
-	  break;
-	case TYPE_F4:
-	  SetPolyF4((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data);
-	  setXYWH((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->vertex0.vx, p_env->p_primParam[index]->vertex0.vy, p_env->p_primParam[index]->dimensions.w, p_env->p_primParam[index]->dimensions.h);
-	  setRGB0((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	  
-	  //update abstract primitive with psx parameters created at its creation
-	  p_env->p_primParam[index]->vertex0.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex1.vx = ((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x1;
-	  p_env->p_primParam[index]->vertex1.vy = ((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y1;
-	  p_env->p_primParam[index]->vertex1.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex2.vx = ((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x2;
-	  p_env->p_primParam[index]->vertex2.vy = ((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y2;
-	  p_env->p_primParam[index]->vertex2.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex3.vx = ((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x3;
-	  p_env->p_primParam[index]->vertex3.vy = ((POLY_F4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y3;
-	  p_env->p_primParam[index]->vertex3.vz = 1024;
-	  
-	  p_env->p_primParam[index]->transCoor.vz = 0;
-	  
-	  p_env->p_primParam[index]->scaleCoor.vx = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vy = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vz = ONE;
-	  break;
-	case TYPE_FT4:
-	  SetPolyFT4((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data);
-	  setUVWH((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->p_texture->vertex0.vx, p_env->p_primParam[index]->p_texture->vertex0.vy, p_env->p_primParam[index]->p_texture->dimensions.w, p_env->p_primParam[index]->p_texture->dimensions.h);
-	  setXYWH((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->vertex0.vx, p_env->p_primParam[index]->vertex0.vy, p_env->p_primParam[index]->dimensions.w, p_env->p_primParam[index]->dimensions.h);
-	  setRGB0((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	  
-	  //update abstract primitive with psx parameters created at its creation
-	  p_env->p_primParam[index]->vertex0.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex1.vx = ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x1;
-	  p_env->p_primParam[index]->vertex1.vy = ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y1;
-	  p_env->p_primParam[index]->vertex1.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex2.vx = ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x2;
-	  p_env->p_primParam[index]->vertex2.vy = ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y2;
-	  p_env->p_primParam[index]->vertex2.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex3.vx = ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x3;
-	  p_env->p_primParam[index]->vertex3.vy = ((POLY_FT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y3;
-	  p_env->p_primParam[index]->vertex3.vz = 1024;
-	  
-	  p_env->p_primParam[index]->transCoor.vz = 0;
-	  
-	  p_env->p_primParam[index]->scaleCoor.vx = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vy = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vz = ONE;
-	  break;
-	case TYPE_G4:
-	  SetPolyG4((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data);
-	  setXYWH((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->vertex0.vx, p_env->p_primParam[index]->vertex0.vy, p_env->p_primParam[index]->dimensions.w, p_env->p_primParam[index]->dimensions.h);       
-	  setRGB0((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	  setRGB1((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color1.r, p_env->p_primParam[index]->color1.g, p_env->p_primParam[index]->color1.b);
-	  setRGB2((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color2.r, p_env->p_primParam[index]->color2.g, p_env->p_primParam[index]->color2.b);
-	  setRGB3((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color3.r, p_env->p_primParam[index]->color3.g, p_env->p_primParam[index]->color3.b);
-	  	  
-	  //update abstract primitive with psx parameters created at its creation
-	  p_env->p_primParam[index]->vertex0.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex1.vx = ((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x1;
-	  p_env->p_primParam[index]->vertex1.vy = ((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y1;
-	  p_env->p_primParam[index]->vertex1.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex2.vx = ((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x2;
-	  p_env->p_primParam[index]->vertex2.vy = ((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y2;
-	  p_env->p_primParam[index]->vertex2.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex3.vx = ((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x3;
-	  p_env->p_primParam[index]->vertex3.vy = ((POLY_G4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y3;
-	  p_env->p_primParam[index]->vertex3.vz = 1024;
-	  
-	  p_env->p_primParam[index]->transCoor.vz = 0;
-	  
-	  p_env->p_primParam[index]->scaleCoor.vx = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vy = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vz = ONE;
-	  break;
-	case TYPE_GT4:
-	  SetPolyGT4((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data);
-	  setUVWH((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->p_texture->vertex0.vx, p_env->p_primParam[index]->p_texture->vertex0.vy, p_env->p_primParam[index]->p_texture->dimensions.w, p_env->p_primParam[index]->p_texture->dimensions.h);
-	  setXYWH((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->vertex0.vx, p_env->p_primParam[index]->vertex0.vy, p_env->p_primParam[index]->dimensions.w, p_env->p_primParam[index]->dimensions.h);      
-	  setRGB0((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	  setRGB1((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color1.r, p_env->p_primParam[index]->color1.g, p_env->p_primParam[index]->color1.b);
-	  setRGB2((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color2.r, p_env->p_primParam[index]->color2.g, p_env->p_primParam[index]->color2.b);
-	  setRGB3((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data, p_env->p_primParam[index]->color3.r, p_env->p_primParam[index]->color3.g, p_env->p_primParam[index]->color3.b);
-	  	  
-	  //update abstract primitive with psx parameters created at its creation
-	  p_env->p_primParam[index]->vertex0.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex1.vx = ((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x1;
-	  p_env->p_primParam[index]->vertex1.vy = ((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y1;
-	  p_env->p_primParam[index]->vertex1.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex2.vx = ((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x2;
-	  p_env->p_primParam[index]->vertex2.vy = ((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y2;
-	  p_env->p_primParam[index]->vertex2.vz = 1024;
-	  
-	  p_env->p_primParam[index]->vertex3.vx = ((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->x3;
-	  p_env->p_primParam[index]->vertex3.vy = ((POLY_GT4 *)p_env->buffer[buffIndex].p_primitive[index].data)->y3;
-	  p_env->p_primParam[index]->vertex3.vz = 1024;
-	  
-	  p_env->p_primParam[index]->transCoor.vz = 0;
-	  
-	  p_env->p_primParam[index]->scaleCoor.vx = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vy = ONE;
-	  p_env->p_primParam[index]->scaleCoor.vz = ONE;
-	  break;
-	default:
-	  printf("\nERROR, NO TYPE DEFINED AT INDEX %d\n", index);
-	  break;
+	p_node = &p_env->grid.p_node[index];
+	
+	//other cells share the bucket
+	if((p_node->cellX != cellX) || (p_node->cellY != cellY))
+	{
+	  continue;
+	}
+	
+	if(!getPrimBox(p_env->p_primParam[index], box))
+	{
+	  continue;
+	}
+	
+	if((box[0] > right) || (box[2] < left) || (box[1] > bottom) || (box[3] < top))
+	{
+	  continue;
+	}
+	
+	if(count >= maxCount)
+	{
+	  return count;
+	}
+	
+	op_index[count++] = index;
       }
-      
-      transPrim(p_env->p_primParam[index], p_env);
-      
-      AddPrim(&(p_env->buffer[buffIndex].p_ot[index]), p_env->buffer[buffIndex].p_primitive[index].data);
     }
   }
+  
+  return count;
 }
 
-//update native primitives for the play station via matrix math 
-void updatePrim(struct s_environment *p_env)
+//box query around the circle, then keep the boxes whose closest point is inside it
+int queryRadius(struct s_environment *p_env, long x, long y, long radius, int *op_index, int maxCount)
 {
   int index;
-  long depthCue;
-  long flag;
+  int count;
+  int found;
+  long box[4];
+  long distX;
+  long distY;
+  
+  found = queryBox(p_env, x - radius, y - radius, x + radius, y + radius, op_index, maxCount);
   
-  for(index = 0; index < p_env->otSize; index++)
+  count = 0;
+  
+  for(index = 0; index < found; index++)
   {
-    SetRotMatrix((MATRIX *)&p_env->p_primParam[index]->matrix);
-    SetTransMatrix((MATRIX *)&p_env->p_primParam[index]->matrix);
+    getPrimBox(p_env->p_primParam[op_index[index]], box);
+    
+    distX = (x < box[0] ? box[0] - x : (x > box[2] ? x - box[2] : 0));
+    distY = (y < box[1] ? box[1] - y : (y > box[3] ? y - box[3] : 0));
     
-    switch(p_env->p_currBuffer->p_primitive[index].type)
+    if(((distX * distX) + (distY * distY)) <= (radius * radius))
     {
-      case TYPE_SPRITE:
-	RotTransPers((SVECTOR *)&p_env->p_primParam[index]->vertex0,
-		     (long *)&((SPRT *)p_env->p_currBuffer->p_primitive[index].data)->x0,
-		     &depthCue, &flag);
-	setWH((SPRT *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->dimensions.w,  p_env->p_primParam[index]->dimensions.h);
-	setUV0((SPRT *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->p_texture->vertex0.vx, p_env->p_primParam[index]->p_texture->vertex0.vy);
-	setRGB0((SPRT *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	break;
-      case TYPE_TILE:
-	RotTransPers((SVECTOR *)&p_env->p_primParam[index]->vertex0,
-		     (long *)&((TILE *)p_env->p_currBuffer->p_primitive[index].data)->x0,
-		     &depthCue, &flag);
-	setXY0((TILE *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->vertex0.vx, p_env->p_primParam[index]->vertex0.vy);
-	setWH((TILE *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->dimensions.w,  p_env->p_primParam[index]->dimensions.h);
-	setRGB0((TILE *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	break;
-      case TYPE_F4:
-	RotTransPers4((SVECTOR *)&p_env->p_primParam[index]->vertex0, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex1, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex2, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex3,
-		      (long *)&(((POLY_F4 *)p_env->p_currBuffer->p_primitive[index].data)->x0),
-		      (long *)&(((POLY_F4 *)p_env->p_currBuffer->p_primitive[index].data)->x1),
-		      (long *)&(((POLY_F4 *)p_env->p_currBuffer->p_primitive[index].data)->x2),
-		      (long *)&(((POLY_F4 *)p_env->p_currBuffer->p_primitive[index].data)->x3),
-		      &depthCue, &flag);
-	setRGB0((POLY_F4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	break;
-      case TYPE_FT4:
-	RotTransPers4((SVECTOR *)&p_env->p_primParam[index]->vertex0,
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex1,
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex2, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex3,
-		      (long *)(&(((POLY_FT4 *)p_env->p_currBuffer->p_primitive[index].data)->x0)),
-		      (long *)(&(((POLY_FT4 *)p_env->p_currBuffer->p_primitive[index].data)->x1)),
-		      (long *)(&(((POLY_FT4 *)p_env->p_currBuffer->p_primitive[index].data)->x2)),
-		      (long *)(&(((POLY_FT4 *)p_env->p_currBuffer->p_primitive[index].data)->x3)),
-		      &depthCue, &flag);
-	setUVWH((POLY_FT4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->p_texture->vertex0.vx, p_env->p_primParam[index]->p_texture->vertex0.vy, p_env->p_primParam[index]->p_texture->dimensions.w, p_env->p_primParam[index]->p_texture->dimensions.h);
-	setRGB0((POLY_FT4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	break;
-      case TYPE_G4:
-	RotTransPers4((SVECTOR *)&p_env->p_primParam[index]->vertex0, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex1, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex2, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex3,
-		      (long *)&((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data)->x0,
-		      (long *)&((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data)->x1,
-		      (long *)&((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data)->x2,
-		      (long *)&((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data)->x3,
-		      &depthCue, &flag);      
-	setRGB0((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	setRGB1((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color1.r, p_env->p_primParam[index]->color1.g, p_env->p_primParam[index]->color1.b);
-	setRGB2((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color2.r, p_env->p_primParam[index]->color2.g, p_env->p_primParam[index]->color2.b);
-	setRGB3((POLY_G4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color3.r, p_env->p_primParam[index]->color3.g, p_env->p_primParam[index]->color3.b);
-	break;
-      case TYPE_GT4:
-	RotTransPers4((SVECTOR *)&p_env->p_primParam[index]->vertex0, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex1, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex2, 
-		      (SVECTOR *)&p_env->p_primParam[index]->vertex3,
-		      (long *)&((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data)->x0,
-		      (long *)&((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data)->x1,
-		      (long *)&((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data)->x2,
-		      (long *)&((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data)->x3,
-		      &depthCue, &flag);
-	setUVWH((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->p_texture->vertex0.vx, p_env->p_primParam[index]->p_texture->vertex0.vy, p_env->p_primParam[index]->p_texture->dimensions.w, p_env->p_primParam[index]->p_texture->dimensions.h);    
-	setRGB0((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color0.r, p_env->p_primParam[index]->color0.g, p_env->p_primParam[index]->color0.b);
-	setRGB1((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color1.r, p_env->p_primParam[index]->color1.g, p_env->p_primParam[index]->color1.b);
-	setRGB2((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color2.r, p_env->p_primParam[index]->color2.g, p_env->p_primParam[index]->color2.b);
-	setRGB3((POLY_GT4 *)p_env->p_currBuffer->p_primitive[index].data, p_env->p_primParam[index]->color3.r, p_env->p_primParam[index]->color3.g, p_env->p_primParam[index]->color3.b);
-	break;
-      default:
-	printf("\nUnknown Type for update at index %d %d\n", index, p_env->p_currBuffer->p_primitive[index].type);
-	break;
+      op_index[count++] = op_index[index];
     }
   }
-}
-
-//use the abstract primitive to generate its native sister primitives updated coordinates
-void transPrim(struct s_primParam *p_primParam, struct s_environment *p_env)
-{
-  p_primParam->realCoor.vx = p_primParam->transCoor.vx - p_primParam->vertex0.vx - p_env->screenCoor.vx;
-  p_primParam->realCoor.vy = p_primParam->transCoor.vy - p_primParam->vertex0.vy - p_env->screenCoor.vy;
-  p_primParam->realCoor.vz = p_primParam->transCoor.vz;
   
-  RotMatrix((SVECTOR *)&p_primParam->rotCoor, (MATRIX *)&p_primParam->matrix);
-  ScaleMatrixL((MATRIX *)&p_primParam->matrix, (VECTOR *)&p_primParam->scaleCoor);
-  TransMatrix((MATRIX *)&p_primParam->matrix, (VECTOR *)&p_primParam->realCoor);
+  return count;
 }
 
-//generic method for moving a primitive
+//generic method for moving a primitive, meant to be a job run every tick
 void movPrim(struct s_environment *p_env)
 { 
   static int prevTime = 0;
 
   if(p_env->gamePad.one.fourth.bit.circle == 0)
   {
-    if(p_env->prevTime == 0 || ((VSync(-1) - p_env->prevTime) > 60))
+    if(checkRate(p_env, &p_env->prevTime, 60))
     {
-      p_env->primCur = (p_env->primCur + 1) % p_env->otSize;
-      p_env->prevTime = VSync(-1);
+      p_env->primCur = (p_env->primCur + 1) % p_env->primSize;
     }
   }
   
   if(p_env->gamePad.one.fourth.bit.ex == 0)
   {
-    if(p_env->prevTime == 0 || ((VSync(-1) - p_env->prevTime) > 60))
+    if(checkRate(p_env, &p_env->prevTime, 60))
     {
       p_env->p_primParam[p_env->primCur]->scaleCoor.vx += 512;
       p_env->p_primParam[p_env->primCur]->scaleCoor.vy += 512;
-      p_env->prevTime = VSync(-1);
     }
   }
   
   if(p_env->gamePad.one.fourth.bit.triangle == 0)
   {
-    if(prevTime == 0 || ((VSync(-1) - prevTime) > 5))
+    if(checkRate(p_env, &prevTime, 6))
     {
       p_env->p_primParam[p_env->primCur]->rotCoor.vz += 128;
-      prevTime = VSync(-1);
     }
   }
   
   if(p_env->gamePad.one.fourth.bit.square == 0)
   {
-    if(prevTime == 0 || ((VSync(-1) - prevTime) > 5))
+    if(checkRate(p_env, &prevTime, 6))
     {
       p_env->p_primParam[p_env->primCur]->transCoor.vz += 32;
-      prevTime = VSync(-1);
     }
   }
   
@@ -750,8 +2777,6 @@ void movPrim(struct s_environment *p_env)
   }
 
   transPrim(p_env->p_primParam[p_env->primCur], p_env);
-  
-  updatePrim(p_env);
 }
 
 //read data from a memory card
@@ -853,5 +2878,83 @@ void memoryCardWrite(char *p_phrase, uint32_t len)
   PadStartCom();
 }
 
+//resize arena, packets already handed out would be lost so only allow it while empty
+int setArenaSize(struct s_environment *p_env, uint32_t size)
+{
+  if(p_env->arena.used != 0)
+  {
+    printf("\nARENA IN USE, RESET BEFORE RESIZE\n");
+    return -1;
+  }
+  
+  free(p_env->arena.p_data);
+  
+  p_env->arena.size = 0;
+  p_env->arena.p_data = malloc(size);
+  
+  if(p_env->arena.p_data == NULL)
+  {
+    printf("\nARENA ALLOCATION FAILED\n");
+    return -1;
+  }
+  
+  p_env->arena.size = size;
+  
+  return 0;
+}
+
+//hand out the next block of the arena, all packets are word aligned
+void *allocArena(struct s_environment *p_env, uint32_t size)
+{
+  void *p_block = NULL;
+  
+  size = (size + 3) & ~3;
+  
+  if((p_env->arena.used + size) > p_env->arena.size)
+  {
+    printf("\nARENA FULL, %d OF %d USED, NEED %d\n", p_env->arena.used, p_env->arena.size, size);
+    return NULL;
+  }
+  
+  p_block = p_env->arena.p_data + p_env->arena.used;
+  
+  memset(p_block, 0, size);
+  
+  p_env->arena.used += size;
+  
+  if(p_env->arena.used > p_env->arena.highWater)
+  {
+    p_env->arena.highWater = p_env->arena.used;
+  }
+  
+  return p_block;
+}
 
- 
+//teardown, every packet pointer is dropped and the arena starts over
+void resetArena(struct s_environment *p_env)
+{
+  int index;
+  int buffIndex;
+  
+  for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
+  {
+    for(index = 0; index < p_env->primSize; index++)
+    {
+      p_env->buffer[buffIndex].p_primitive[index].data = NULL;
+      p_env->buffer[buffIndex].p_primitive[index].p_tpage = NULL;
+    }
+    
+    ClearOTagR(p_env->buffer[buffIndex].p_ot, p_env->otSize);
+  }
+  
+  //the tilemap ring was carved from the arena too, setTilemap again after populateOT
+  memset(&p_env->tilemap, 0, sizeof(p_env->tilemap));
+  
+  p_env->arena.used = 0;
+}
+
+//print arena stats to the debug console
+void reportArena(struct s_environment *p_env)
+{
+  printf("\nARENA USED %d HIGH WATER %d SIZE %d\n", p_env->arena.used, p_env->arena.highWater, p_env->arena.size);
+}
@@ -26,37 +26,164 @@
 
 #define SCREEN_WIDTH  320 // screen width
 #define	SCREEN_HEIGHT 240 // screen height
+#define OT_DEFAULT_SIZE 1024 // ordering table depth used when initEnv is given none
+#define OTZ_DEFAULT_MAX 16383 // otzMax initEnv sets, the largest otz the gte returns
 
 extern u_long __ramsize;  //  = 0x00200000;  force 2 megabytes of RAM
 extern u_long __stacksize; // = 0x00004000; force 16 kilobytes of stack
 
-//setup environment and set the number of primitives (sets otSize (ordering table size) to this).
-void initEnv(struct s_environment *p_env, int numPrim);
+//setup environment, set the number of primitives, the ordering table depth (less than 1 uses OT_DEFAULT_SIZE)
+//and the number of display buffers (DOUBLE_BUF or TRIPLE_BUF, the third uses vram at 640,0 to 960,240).
+//textRect starts as the whole font window, nearly all of the screen, so useDirtyRect redraws about everything
+//every frame until the title sets textRect to the lines it prints.
+void initEnv(struct s_environment *p_env, int numPrim, int otSize, int bufCount);
 //setup sound for cd
 void setupSound(struct s_environment *p_env);
 //play cd tracks (loops all tracks)
 void playCDtracks(int *p_tracks, int trackNum);
 //update display
 void display(struct s_environment *p_env);
-//populate textures
-void populateTextures(struct s_environment *p_env);
+//populate textures, returns -1 if the arena has no room for the packets
+int populateTextures(struct s_environment *p_env);
+//load a bitmap texture (file, dimensions and vramVertex set) from CD to vram, sets its id. returns 0 or -1.
+int loadTexture(struct s_texture *p_texture);
+//load a texture through the residency table, a file already in vram at the same vramVertex is shared (id) and its count raised. returns 0 or -1.
+int acquireTexture(struct s_environment *p_env, struct s_texture *p_texture);
+//drop one reference to a texture from acquireTexture, the entry (and its vram) is free once none are left
+void releaseTexture(struct s_environment *p_env, struct s_texture *p_texture);
 //load a tim from CD, return address to load tim from in memory.
 void *loadFileFromCD(char *p_path, uint32_t *op_len);
-//get objects from xml files
+//get objects from xml files, each file is parsed once and kept as a template that later calls copy
 struct s_primParam *getObjects(char *fileName);
-//cleanup primitives
-void freeObjects(struct s_primParam **p_primParam);
-//call to populate the ordering table with primitives.
-void populateOT(struct s_environment *p_env);
+//copy an object (and its texture description, not its pixel data), returns NULL on failure
+struct s_primParam *copyObject(struct s_primParam *p_primParam);
+//free the templates getObjects keeps, call on level changes
+void flushObjects();
+//get the getObjects template hits and misses since the last call and reset them
+void getObjectStats(int *op_hits, int *op_misses);
+//get objects from a xml scene file (SCENE root, one prim element per object) into p_primParam from start, returns count or -1
+int getScene(struct s_environment *p_env, char *fileName, int start);
+//get objects from a binary scene compiled by libgetprim/primc into p_primParam from start, returns count or -1
+int getSceneBin(struct s_environment *p_env, char *fileName, int start);
+//cleanup primitives, gives back the texture populateTextures loaded for it
+void freeObjects(struct s_environment *p_env, struct s_primParam **p_primParam);
+//call to populate the ordering table with primitives, returns -1 if the arena has no room for the packets.
+int populateOT(struct s_environment *p_env);
 //call to update the position of primitives if it has been altered
 void updatePrim(struct s_environment *p_env);
-//translate current primitive
+//translate current primitive, marks it dirty only if its position, rotation or scale changed.
+//unrotated, unscaled primitives at z = 0 (or flagged PRIM_FLAG_FORCE_2D) skip the gte and are placed with adds
 void transPrim(struct s_primParam *p_primParam, struct s_environment *p_env);
-//simple move routine to keep primitives within the screen
+//set how display hands frames to the gpu, FRAME_SYNC (default) or FRAME_PIPELINED.
+void setFrameMode(struct s_environment *p_env, enum en_frameMode mode);
+//register a fixed rate update job, run every rate ticks (TICK_RATE a second), returns its index or -1 when full.
+int addJob(struct s_environment *p_env, void (*p_update)(struct s_environment *p_env), int rate);
+//run registered jobs once per tick passed since the last call, call once per rendered frame.
+void runJobs(struct s_environment *p_env);
+//true once rate ticks have passed since *op_prevTick, then sets it to the current tick (button repeat and such).
+int checkRate(struct s_environment *p_env, int *op_prevTick, int rate);
+//link primitives start to start + count - 1 into one chain per buffer after populateOT, updatePrim then splices
+//the chain into the table with one link and never touches them. they are never culled, and are placed at the
+//table slot of the deepest member. cameraMode must be CAMERA_OFFSET, the packets keep world coordinates and the
+//draw offset scrolls them, with CAMERA_TRANSFORM they would stay put on screen. returns the group or -1, remove the
+//group to change its members.
+int addStaticGroup(struct s_environment *p_env, int start, int count);
+//give the members of a static group back to updatePrim, they are rewritten in every buffer.
+void removeStaticGroup(struct s_environment *p_env, int group);
+//primitives static groups kept out of the last updatePrim (not culled, transformed, written or linked one by one),
+//in every build. profile builds also show an estimate of the cycles that saved.
+int getStaticSaved(struct s_environment *p_env);
+//draw primitives start to start + count - 1 once into a background layer in vram at vramX, vramY (sized to the
+//world box around them, off the display buffers) after populateTextures. updatePrim copies the part in view to
+//the start of every frame and the buffer is only cleared where the layer does not cover it.
+//members are drawn in index order, never updated, returns 0 or -1.
+int addBackground(struct s_environment *p_env, int start, int count, int vramX, int vramY);
+//drop the background layer, its members go back to updatePrim.
+void removeBackground(struct s_environment *p_env);
+//draw p_tiles (width by height tile indexes row by row, TILE_EMPTY for none) from the world top left behind
+//everything else. tiles are tileSize (8 or 16) square, cut left to right and top to bottom from p_texture, which
+//has to be in vram. packets come from the arena, size it for a ring of screen tiles per buffer. returns 0 or -1.
+int setTilemap(struct s_environment *p_env, uint8_t *p_tiles, int width, int height, int tileSize, struct s_texture *p_texture);
+//world box of a primitive as left, top, right and bottom, grown to cover its scale and rotation.
+//returns 0 for primitives off the z = 0 plane, they have no box.
+int getPrimBox(struct s_primParam *p_primParam, long *op_box);
+//put a primitive in the spatial grid cell under its box, transPrim and populateOT do this.
+void placeGrid(struct s_environment *p_env, struct s_primParam *p_primParam);
+//take a primitive out of the spatial grid until it is placed again.
+void leaveGrid(struct s_environment *p_env, struct s_primParam *p_primParam);
+//indexes of primitives whose box overlaps left, top, right, bottom (world), up to maxCount. returns the count.
+int queryBox(struct s_environment *p_env, long left, long top, long right, long bottom, int *op_index, int maxCount);
+//indexes of primitives whose box is within radius of x, y (world), up to maxCount. returns the count.
+int queryRadius(struct s_environment *p_env, long x, long y, long radius, int *op_index, int maxCount);
+//mark parts of a primitive changed (DIRTY_TRANS, DIRTY_COLOR, DIRTY_UV) so updatePrim rewrites them in every buffer
+void markPrim(struct s_environment *p_env, struct s_primParam *p_primParam, uint8_t flags);
+//simple move routine to keep primitives within the screen, register it with addJob and call updatePrim every frame
 void movPrim(struct s_environment *p_env);
 //read from the memory card and return pointer to data
 char *memoryCardRead(uint32_t len);
 //write to the memory card using data passed to it.
 void memoryCardWrite(char *p_phrase, uint32_t len);
+//resize the packet arena, only allowed before anything has been carved from it (returns 0 on success, -1 on failure).
+int setArenaSize(struct s_environment *p_env, uint32_t size);
+//carve a 4 byte aligned block out of the packet arena, NULL if it is full.
+void *allocArena(struct s_environment *p_env, uint32_t size);
+//give every packet back to the arena in one go (level teardown), populateOT will carve new ones.
+void resetArena(struct s_environment *p_env);
+//print arena usage and high water mark, use it to size the arena for a title.
+void reportArena(struct s_environment *p_env);
+
+//inline gte fast path (gte.c), the rotation and translation must already be loaded.
+//project one vertex, returns otz like RotTransPers.
+long gtePoint(SVECTOR *p_vertex0, long *op_xy0);
+//project the corners of a quad, returns otz like RotTransPers4.
+long gteQuad(SVECTOR *p_vertex0, SVECTOR *p_vertex1, SVECTOR *p_vertex2, SVECTOR *p_vertex3, long *op_xy0, long *op_xy1, long *op_xy2, long *op_xy3);
+
+//profiler zones, times are in screen lines. build the engine and the title with PSX_DEFINES=-DENGINE_PROFILE
+//to turn it on, without it the PROF_ macros compile to nothing.
+enum en_profZone {PROF_DISPLAY_WAIT, PROF_GPU, PROF_UPDATE, PROF_TRANS, PROF_USER, PROF_FRAME, PROF_ZONES};
+
+#ifdef ENGINE_PROFILE
+//start root counter one, called by initEnv
+void initProfile();
+//start timing a zone
+void profBegin(enum en_profZone zone);
+//stop timing a zone, time adds up if a zone is entered more than once a frame
+void profEnd(enum en_profZone zone);
+//close the current frame and store its zone totals, called by display
+void profFrame();
+//FntPrint min/avg/max of every zone over the last frames, called by display under the header
+void profPrint();
+//printf every stored frame, comma separated, for capture over SIO
+void profDump();
+//start counting cpu cycles
+void profCyclesBegin();
+//stop counting cycles, the average per item is shown by profPrint
+void profCyclesEnd(int count);
+//primitives linked by static groups this frame, profPrint shows them times cycles per prim as an estimate of the cycles saved
+void profStatic(int count);
+
+#define PROF_INIT()       initProfile()
+#define PROF_BEGIN(zone)  profBegin(zone)
+#define PROF_END(zone)    profEnd(zone)
+#define PROF_FRAME_END()  profFrame()
+#define PROF_PRINT()      profPrint()
+#define PROF_DUMP()       profDump()
+#define PROF_CYCLES_BEGIN()    profCyclesBegin()
+#define PROF_CYCLES_END(count) profCyclesEnd(count)
+#define PROF_STATIC(count)     profStatic(count)
+//lines profPrint adds under the header, the zone title, one per zone, cycles and statics
+#define PROF_PRINT_LINES (PROF_ZONES + 3)
+#else
+#define PROF_INIT()
+#define PROF_BEGIN(zone)
+#define PROF_END(zone)
+#define PROF_FRAME_END()
+#define PROF_PRINT()
+#define PROF_DUMP()
+#define PROF_CYCLES_BEGIN()
+#define PROF_CYCLES_END(count)
+#define PROF_STATIC(count)
+#define PROF_PRINT_LINES 0
+#endif
 
 #endif
\ No newline at end of file
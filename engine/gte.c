@@ -0,0 +1,41 @@
+/*
+ * GTE fast path, projects primitive vertices with inline GTE instructions instead of RotTransPers calls,
+ * screen coordinates are stored from the GTE registers straight into the packet.
+ *
+ * inline_c.h leaves placeholders in the object that DMPSX turns into GTE instructions, the makefile runs it
+ * on this object only. Rotation and translation must already be loaded (SetRotMatrix/SetTransMatrix).
+ *
+*/
+
+#include "engine.h"
+#include <inline_c.h>
+
+//project one vertex (sprites, tiles), returns sz / 4 like RotTransPers
+long gtePoint(SVECTOR *p_vertex0, long *op_xy0)
+{
+  long sz;
+  
+  gte_ldv0(p_vertex0);
+  gte_rtps();
+  gte_stsxy(op_xy0);
+  gte_stsz(&sz);
+  
+  return sz >> 2;
+}
+
+//project the corners of a quad, three in one rtpt and the last with rtps, returns sz / 4 of the last like RotTransPers4
+long gteQuad(SVECTOR *p_vertex0, SVECTOR *p_vertex1, SVECTOR *p_vertex2, SVECTOR *p_vertex3, long *op_xy0, long *op_xy1, long *op_xy2, long *op_xy3)
+{
+  long sz;
+  
+  gte_ldv3(p_vertex0, p_vertex1, p_vertex2);
+  gte_rtpt();
+  gte_stsxy3(op_xy0, op_xy1, op_xy2);
+  
+  gte_ldv0(p_vertex3);
+  gte_rtps();
+  gte_stsxy(op_xy3);
+  gte_stsz(&sz);
+  
+  return sz >> 2;
+}
@@ -0,0 +1,176 @@
+/*
+ * Frame profiler for the engine, times phases of a frame with root counter 1 (counts horizontal syncs, one
+ * per screen line) so results read as screen lines, 263 (NTSC) or 314 (PAL) lines is a full frame.
+ *
+ * Totals per zone are kept for each frame in a ring buffer, min/avg/max over the ring are printed under the
+ * FntPrint header and the ring can be dumped to the SIO link (printf goes there once AddSIO is called).
+ *
+ * Only built with ENGINE_PROFILE defined, the PROF_ macros in engine.h compile to nothing without it.
+ *
+*/
+
+#include "engine.h"
+
+#ifdef ENGINE_PROFILE
+
+#include <libapi.h>
+
+//number of frames kept in the ring
+#define PROF_RING_SIZE 64
+
+//names for the hud and dump, same order as en_profZone
+char const * const gc_profZoneName[] = {"WAIT", "GPU ", "UPD ", "TRNS", "USER", "FRM "};
+
+//holds all profile data
+struct
+{
+  int ringIndex;
+  int ringCount;
+
+  uint16_t start[PROF_ZONES];
+  uint32_t frame[PROF_ZONES];
+
+  uint16_t ring[PROF_RING_SIZE][PROF_ZONES];
+  
+  uint16_t cycleStart;
+  uint32_t cyclesPerItem;
+  uint32_t staticItems;
+
+} g_profData;
+
+//setup root counter one to count screen lines, and counter two (system clock / 8) for cycle counts
+void initProfile()
+{
+  memset(&g_profData, 0, sizeof(g_profData));
+
+  SetRCnt(RCntCNT1, 0xFFFF, RCntMdNOINTR);
+  StartRCnt(RCntCNT1);
+  
+  SetRCnt(RCntCNT2, 0xFFFF, RCntMdNOINTR);
+  StartRCnt(RCntCNT2);
+}
+
+//start timing a zone
+void profBegin(enum en_profZone zone)
+{
+  g_profData.start[zone] = (uint16_t)GetRCnt(RCntCNT1);
+}
+
+//stop timing a zone, zones can be entered many times a frame (transPrim), time adds up
+void profEnd(enum en_profZone zone)
+{
+  g_profData.frame[zone] += (uint16_t)((uint16_t)GetRCnt(RCntCNT1) - g_profData.start[zone]);
+}
+
+//start counting cpu cycles, the counter wraps after about 15ms so keep it to one pass over the primitives
+void profCyclesBegin()
+{
+  g_profData.cycleStart = (uint16_t)GetRCnt(RCntCNT2);
+}
+
+//stop counting cycles and keep the average over count items
+void profCyclesEnd(int count)
+{
+  if(count > 0)
+  {
+    g_profData.cyclesPerItem = ((uint32_t)(uint16_t)((uint16_t)GetRCnt(RCntCNT2) - g_profData.cycleStart) * 8) / count;
+  }
+}
+
+//keep the number of primitives static groups linked without updatePrim touching them
+void profStatic(int count)
+{
+  g_profData.staticItems = count;
+}
+
+//close the frame, store its totals in the ring and start the next one
+void profFrame()
+{
+  int index;
+
+  //frame zone runs from one profFrame to the next
+  profEnd(PROF_FRAME);
+
+  for(index = 0; index < PROF_ZONES; index++)
+  {
+    g_profData.ring[g_profData.ringIndex][index] = (g_profData.frame[index] > 0xFFFF ? 0xFFFF : g_profData.frame[index]);
+    g_profData.frame[index] = 0;
+  }
+
+  g_profData.ringIndex = (g_profData.ringIndex + 1) % PROF_RING_SIZE;
+
+  if(g_profData.ringCount < PROF_RING_SIZE)
+  {
+    g_profData.ringCount++;
+  }
+
+  profBegin(PROF_FRAME);
+}
+
+//print min/avg/max of every zone over the ring with FntPrint
+void profPrint()
+{
+  int index;
+  int zone;
+  uint32_t min;
+  uint32_t max;
+  uint32_t sum;
+
+  if(g_profData.ringCount == 0)
+  {
+    return;
+  }
+
+  FntPrint("\nZONE MIN AVG MAX (LINES)");
+
+  for(zone = 0; zone < PROF_ZONES; zone++)
+  {
+    min = 0xFFFF;
+    max = 0;
+    sum = 0;
+
+    for(index = 0; index < g_profData.ringCount; index++)
+    {
+      min = (g_profData.ring[index][zone] < min ? g_profData.ring[index][zone] : min);
+      max = (g_profData.ring[index][zone] > max ? g_profData.ring[index][zone] : max);
+      sum += g_profData.ring[index][zone];
+    }
+
+    FntPrint("\n%s %d %d %d", gc_profZoneName[zone], min, sum / g_profData.ringCount, max);
+  }
+  
+  FntPrint("\nCYCLES PER PRIM %d", g_profData.cyclesPerItem);
+  
+  //not measured, what the static primitives would have cost at this frame's cycles per primitive
+  if(g_profData.staticItems > 0)
+  {
+    FntPrint("\nSTATIC %d EST SAVED %d CYCLES", g_profData.staticItems, g_profData.staticItems * g_profData.cyclesPerItem);
+  }
+}
+
+//dump the ring oldest frame first, one line per frame, comma separated
+void profDump()
+{
+  int index;
+  int zone;
+  int frame;
+
+  printf("\nPROFILE DUMP %d FRAMES (LINES)\n", g_profData.ringCount);
+
+  for(zone = 0; zone < PROF_ZONES; zone++)
+  {
+    printf("%s%c", gc_profZoneName[zone], (zone == PROF_ZONES - 1 ? '\n' : ','));
+  }
+
+  for(index = 0; index < g_profData.ringCount; index++)
+  {
+    frame = (g_profData.ringIndex - g_profData.ringCount + index + PROF_RING_SIZE) % PROF_RING_SIZE;
+
+    for(zone = 0; zone < PROF_ZONES; zone++)
+    {
+      printf("%d%c", g_profData.ring[frame][zone], (zone == PROF_ZONES - 1 ? '\n' : ','));
+    }
+  }
+}
+
+#endif
@@ -5,7 +5,9 @@
  * 
  * Library for getting primitive data in a cross platform manner. 
  * 
- * 
+ * The xml is walked once, every yxml event is matched against the element stack and the value lands
+ * in s_primParam when its element closes, so fields can come in any order.
+ *
  */
 #include "getprim.h"
 #include <string.h>
@@ -13,18 +15,41 @@
 #include <yxml.h>
 
 #define DEFAULT_BUFSIZE 2048
+//deepest element nesting kept on the tag stack, anything deeper is parsed but ignored
+#define MAX_TAG_DEPTH   8
+
+//fields found so far, getPrimData checks the required ones once the document is done
+#define FOUND_TYPE      0x001
+#define FOUND_VERTEX0   0x002
+#define FOUND_COLOR0    0x004
+#define FOUND_WIDTH     0x008
+#define FOUND_HEIGHT    0x010
+#define FOUND_TVERTEX0  0x020
+#define FOUND_VRAM      0x040
+#define FOUND_TWIDTH    0x080
+#define FOUND_THEIGHT   0x100
+#define FOUND_FILE      0x200
+
+//element names the parser knows, must match the order of gc_xmlTag
+enum en_xmlTag {TAG_VERTEX_0, TAG_VERTEX_1, TAG_VERTEX_2, TAG_VERTEX_3, TAG_VRAM, TAG_X_CORR, TAG_Y_CORR, TAG_COLOR_0, TAG_COLOR_1, TAG_COLOR_2, TAG_COLOR_3, TAG_RED, TAG_GREEN, TAG_BLUE, TAG_WIDTH, TAG_HEIGHT, TAG_TWIDTH, TAG_THEIGHT, TAG_TEXTURE, TAG_FILE, TAG_OTHER};
 
 //holds data relating to xml parsing
 struct
 {
   int bufSize;
+  int bytesParsed;
   char stringBuffer[256];
+  int stringIndex;
+
+  int found;
+  int depth;
+  int textureDepth;
+  enum en_xmlTag tagStack[MAX_TAG_DEPTH];
   
   yxml_t yxml;
   
   char p_stack[DEFAULT_BUFSIZE];
   char const *p_xmlData;
-  char const *p_xmlDataBlock;
   char const *p_xmlDataStart;
   
 } g_parserData;
@@ -32,51 +57,29 @@ struct
 
 //defines of names for xmltypes
 #define XML_TYPE_NAME "type"
-#define XML_VERTEX_0  "vertex0"
-#define XML_VERTEX_1  "vertex1"
-#define XML_VERTEX_2  "vertex2"
-#define XML_VERTEX_3  "vertex3"
-#define XML_VRAM      "vramVertex"
-#define XML_X_CORR    "x"
-#define XML_Y_CORR    "y"
-#define XML_COLOR_0   "color0"
-#define XML_COLOR_1   "color1"
-#define XML_COLOR_2   "color2"
-#define XML_COLOR_3   "color3"
-#define XML_RED	      "red"
-#define XML_GREEN     "green"
-#define XML_BLUE      "blue"
-#define XML_WIDTH     "width"
-#define XML_HEIGHT    "height"
-#define XML_TWIDTH    "twidth"
-#define XML_THEIGHT   "theight"
-#define XML_TEXTURE   "texture"
-#define XML_FILE      "file"
+#define XML_SCENE     "SCENE"
+
+//lookup for element names, same order as en_xmlTag
+char const * const gc_xmlTag[] = {"vertex0", "vertex1", "vertex2", "vertex3", "vramVertex", "x", "y", "color0", "color1", "color2", "color3", "red", "green", "blue", "width", "height", "twidth", "theight", "texture", "file", "END"};
 
 //lookup for prim types, these must be done in the same order as the enum, since I use the index to set the type (ints = enum)
 char const * const gc_primType[] = {"TYPE_F4", "TYPE_FT4", "TYPE_G4", "TYPE_GT4", "TYPE_SPRITE", "TYPE_TILE", "END"};
 
 //helper functions
-//finds the attribute and stores the result in stringBuffer, returns 0 if found, -1 if not
-int findXMLattr(char const * const p_attr);
-//finds the element and stores the result in stringBuffer, returns 0 if found, -1 if not
-int findXMLelem(char const * const p_elem);
-//finds an element name that starts a block of data, returns 0 if found , -1 if not
-int findXMLblock(char const * const p_block);
-//gets content if attribute or element is found, puts data in stringBuffer, returns 0 if found, -1 if not
-int getXMLcontent();
-//finds vertex data out of the xml, 0 if found, -1 if not found
-int findLVertex(struct s_lvertex *p_vertex, char const * const p_vertexName);
-//finds vertex data out of the xml, 0 if found, -1 if not found
-int findSVertex(struct s_svertex *p_vertex, char const * const p_vertexName);
-//finds color data out of the xml, 0 if found, -1 if not found
-int findColor(struct s_color *color, char const * const p_colorName);
-//sets the current block data pointer so we can loop within the same block of data
-void setXMLblock();
-//reset data back to start, allows data to be in any order
+//parse one prim element that is a child of the element at baseDepth, op_primParam gets the prim or NULL
+int parsePrim(struct s_primParam **op_primParam, int baseDepth);
+//check required fields of a parsed prim, frees it and returns -1 if one is missing
+int checkPrim(struct s_primParam *p_primParam);
+//get the tag for an element name, TAG_OTHER if it is not one we use
+enum en_xmlTag findXMLtag(char const * const p_elem);
+//add yxml data bytes to stringBuffer, returns 0 on success, -1 if the buffer is full
+int addXMLcontent();
+//store stringBuffer into the field the element stack points at, called when a element closes
+void setPrimField(struct s_primParam *p_primParam);
+//set the prim type from the type attribute in stringBuffer
+void setPrimType(struct s_primParam *p_primParam);
+//reset data back to start, allows the same data to be parsed again
 void resetXMLstart();
-//reset data back to where setXMLblock was last called, allows a block to be searched in its range
-void resetXMLblock();
 
 //setup get prim data
 void initGetPrimData()
@@ -85,6 +88,7 @@ void initGetPrimData()
   g_parserData.p_xmlDataStart = NULL;
   
   g_parserData.bufSize = DEFAULT_BUFSIZE;
+  g_parserData.bytesParsed = 0;
   
   memset(g_parserData.stringBuffer, 0, 256);
   
@@ -103,12 +107,14 @@ int resetGetPrimData()
   yxml_init(&g_parserData.yxml, g_parserData.p_stack, g_parserData.bufSize);
   
   resetXMLstart();
+
+  return 0;
 }
 
 //free data
 void freePrimData(struct s_primParam **p_primParam)
 {
-  if(p_primParam != NULL)
+  if((p_primParam != NULL) && (*p_primParam != NULL))
   {
     if((*p_primParam)->p_texture != NULL)
     {
@@ -121,6 +127,8 @@ void freePrimData(struct s_primParam **p_primParam)
     }
     
     free(*p_primParam);
+
+    *p_primParam = NULL;
   }
 }
 
@@ -134,13 +142,16 @@ void setXMLdata(char const *p_xmlData)
   }
 }
 
+//bytes yxml was fed by the last getPrimData or getSceneData
+int getPrimDataBytes()
+{
+  return g_parserData.bytesParsed;
+}
+
 //get prim data (parse xml)
 struct s_primParam *getPrimData()
 {
-  int index;
-  int returnValue = 0;
-  
-  struct s_primParam *p_primParam;
+  struct s_primParam *p_primParam = NULL;
   
   if(g_parserData.p_xmlData == NULL)
   {
@@ -148,408 +159,475 @@ struct s_primParam *getPrimData()
     return NULL;
   }
   
-  p_primParam = calloc(1, sizeof(*p_primParam));
-  
-  if(p_primParam == NULL)
+  g_parserData.depth = 0;
+  g_parserData.bytesParsed = 0;
+
+  //the root element is the prim
+  parsePrim(&p_primParam, 0);
+
+  return p_primParam;
+}
+
+//get every prim in a scene (parse xml), fills op_primParam in file order
+int getSceneData(struct s_primParam **op_primParam, int maxPrim)
+{
+  int count = 0;
+  int returnValue = 0;
+  yxml_ret_t yxmlState = YXML_OK;
+
+  if(g_parserData.p_xmlData == NULL)
   {
-    printf("BAD ALLOC\n");
-    return NULL;
+    printf("XML DATA NULL\n");
+    return -1;
   }
-  
-  memset(p_primParam, 0, sizeof(*p_primParam));
-  
-  p_primParam->p_texture = NULL;
-  
-  if(findXMLattr(XML_TYPE_NAME) < 0)
+
+  if(op_primParam == NULL)
   {
-    printf("DID NOT FIND TYPE NAME\n");
-    free(p_primParam);
-    return NULL;
+    return -1;
   }
-  
-  for(index = 0; strcmp(gc_primType[index], "END") != 0; index++)
+
+  g_parserData.depth = 0;
+  g_parserData.bytesParsed = 0;
+
+  //find the scene root
+  while(*g_parserData.p_xmlData && (yxmlState != YXML_ELEMSTART))
   {
-    if(strcmp(gc_primType[index], g_parserData.stringBuffer) == 0)
+    yxmlState = yxml_parse(&g_parserData.yxml, *g_parserData.p_xmlData);
+
+    g_parserData.p_xmlData++;
+    g_parserData.bytesParsed++;
+
+    if(yxmlState < 0)
     {
-      p_primParam->type = (enum en_primType)index;
-      break;
+      printf("BAD SCENE XML\n");
+      return -1;
     }
   }
-  
-  returnValue = findLVertex(&p_primParam->transCoor, XML_VERTEX_0);
-  
-  if(returnValue < 0)
-  {
-    printf("COULD NOT FIND VERTEX 0\n");
-    free(p_primParam);
-    return NULL;
-  }
-  
-  returnValue = findColor(&p_primParam->color0, XML_COLOR_0);
-  
-  if(returnValue < 0)
-  {
-    printf("COULD NOT FIND COLOR 0\n");
-    free(p_primParam);
-    return NULL;
-  }
-  
-  findColor(&p_primParam->color1, XML_COLOR_1);
-  
-  findColor(&p_primParam->color1, XML_COLOR_2);
-  
-  findColor(&p_primParam->color1, XML_COLOR_3);
-  
-  if(findXMLelem(XML_WIDTH) < 0)
-  {
-    printf("COULD NOT FIND WIDTH\n");
-    free(p_primParam);
-    return NULL;
-  }
 
-  p_primParam->dimensions.w = atoi(g_parserData.stringBuffer);
-  
-  resetXMLstart();
-  
-  if(findXMLelem(XML_HEIGHT) < 0)
+  if((yxmlState != YXML_ELEMSTART) || (strcmp(g_parserData.yxml.elem, XML_SCENE) != 0))
   {
-    printf("COULD NOT FIND HEIGHT\n");
-    free(p_primParam);
-    return NULL;
+    printf("DID NOT FIND SCENE\n");
+    return -1;
   }
-  
-  p_primParam->dimensions.h = atoi(g_parserData.stringBuffer);
-  
-  p_primParam->vertex0.vx = -(p_primParam->dimensions.w/2);
-  p_primParam->vertex0.vy = -(p_primParam->dimensions.h/2);
-  
-  resetXMLstart();
-  
-  //get texture info
-  if(findXMLblock(XML_TEXTURE) == 0)
+
+  g_parserData.depth = 1;
+
+  //each child of the scene is a prim, a prim that fails its checks leaves a NULL so indexes stay in file order
+  while(count < maxPrim)
   {
-    //keep us within this block now that we have found it.
-    setXMLblock();
-    
-    p_primParam->p_texture = calloc(1, sizeof(*p_primParam->p_texture));
+    op_primParam[count] = NULL;
 
-    if(p_primParam->p_texture == NULL)
-    {
-      free(p_primParam);
-      return NULL;
-    }
-    
-    returnValue = findSVertex(&p_primParam->p_texture->vertex0, XML_VERTEX_0);
-    
-    if(returnValue < 0)
-    {
-      printf("COULD NOT FIND VERTEX 0\n");
-      free(p_primParam);
-      return NULL;
-    }
-    
-    resetXMLblock();
-    
-    returnValue = findSVertex(&p_primParam->p_texture->vramVertex, XML_VRAM);
-    
-    if(returnValue < 0)
-    {
-      printf("COULD NOT FIND VRAM\n");
-      free(p_primParam);
-      return NULL;
-    }
-    
-    resetXMLblock();
-      
-    if(findXMLelem(XML_TWIDTH) < 0)
-    {
-      free(p_primParam);
-      return NULL;
-    }
-    
-    p_primParam->p_texture->dimensions.w = atoi(g_parserData.stringBuffer);
-    
-    resetXMLblock();
-    
-    if(findXMLelem(XML_THEIGHT) < 0)
+    returnValue = parsePrim(&op_primParam[count], 1);
+
+    //a prim read before a xml error is still kept
+    if((returnValue > 0) || (op_primParam[count] != NULL))
     {
-      free(p_primParam);
-      return NULL;
+      count++;
     }
-    
-    p_primParam->p_texture->dimensions.h = atoi(g_parserData.stringBuffer);
-    
-    resetXMLblock();
-    
-    if(findXMLelem(XML_FILE) < 0)
+
+    if(returnValue <= 0)
     {
-      free(p_primParam);
-      return NULL;
+      break;
     }
-    
-    strcpy(p_primParam->p_texture->file, g_parserData.stringBuffer);
   }
-  
-  return p_primParam;
+
+  return count;
 }
 
-//find attributes
-int findXMLattr(char const * const p_attr)
+//parse a prim, returns 1 if the prim element was read (prim can still be NULL if it failed a check), 0 if its parent closed first, -1 on xml error
+int parsePrim(struct s_primParam **op_primParam, int baseDepth)
 {
-  yxml_ret_t yxmlState;
-  
-  do
+  int returnValue = 0;
+  yxml_ret_t yxmlState = YXML_OK;
+
+  struct s_primParam *p_primParam = NULL;
+
+  g_parserData.found = 0;
+  g_parserData.textureDepth = 0;
+  g_parserData.stringIndex = 0;
+
+  //one pass, stops when the prim element closes or yxml reports an error
+  while(*g_parserData.p_xmlData)
   {
     yxmlState = yxml_parse(&g_parserData.yxml, *g_parserData.p_xmlData);
-    
-    switch(yxmlState)
-    {
-      case YXML_ATTRSTART:
-	if(strcmp(g_parserData.yxml.attr, p_attr) == 0)
-	{
-	  return getXMLcontent();
-	}
-	break;
-      default:
-	break;
-    }
+
     g_parserData.p_xmlData++;
-  }
-  while(*g_parserData.p_xmlData);
-  
-  return -1;
-}
+    g_parserData.bytesParsed++;
 
-//find elements
-int findXMLelem(char const * const p_elem)
-{
-  yxml_ret_t yxmlState;
-  
-  do
-  {
-    yxmlState = yxml_parse(&g_parserData.yxml, *g_parserData.p_xmlData);
-    
-    switch(yxmlState)
+    if(yxmlState < 0)
     {
-      case YXML_ELEMSTART:
-	if(strcmp(g_parserData.yxml.elem, p_elem) == 0)
-	{
-	  return getXMLcontent();
-	}
-	break;
-      default:
-	break;
+      returnValue = -1;
+      break;
     }
-    g_parserData.p_xmlData++;
-  }
-  while(*g_parserData.p_xmlData);
-  
-  return -1;
-}
 
-//find element blocks
-int findXMLblock(char const * const p_block)
-{
-  yxml_ret_t yxmlState;
+    //skip up to the start of the prim element, or stop if the parent closes
+    if(p_primParam == NULL)
+    {
+      if(yxmlState == YXML_ELEMEND)
+      {
+	g_parserData.depth--;
+	return 0;
+      }
+
+      if(yxmlState != YXML_ELEMSTART)
+      {
+	continue;
+      }
+
+      p_primParam = calloc(1, sizeof(*p_primParam));
+
+      if(p_primParam == NULL)
+      {
+	printf("BAD ALLOC\n");
+	return -1;
+      }
+
+      p_primParam->p_texture = NULL;
+    }
 
-  do
-  {
-    yxmlState = yxml_parse(&g_parserData.yxml, *g_parserData.p_xmlData);
-    
     switch(yxmlState)
     {
       case YXML_ELEMSTART:
-	if(strcmp(g_parserData.yxml.elem, p_block) == 0)
+	if(g_parserData.depth < MAX_TAG_DEPTH)
 	{
-	  return 0;
-	}
-	break;
-      default:
-	break;
-    }
-    g_parserData.p_xmlData++;
-  }
-  while(*g_parserData.p_xmlData);
-  
-  return -1;
-}
+	  g_parserData.tagStack[g_parserData.depth] = findXMLtag(g_parserData.yxml.elem);
 
-//get content when a element match is found (or attribute).
-int getXMLcontent()
-{
-  int len = 0;
-  int index = 0;
-  yxml_ret_t yxmlState;
+	  //texture fields are only taken from inside the texture block
+	  if((g_parserData.tagStack[g_parserData.depth] == TAG_TEXTURE) && (p_primParam->p_texture == NULL))
+	  {
+	    p_primParam->p_texture = calloc(1, sizeof(*p_primParam->p_texture));
 
-  memset(g_parserData.stringBuffer, 0, 256);
-  
-  do
-  {
-    yxmlState = yxml_parse(&g_parserData.yxml, *g_parserData.p_xmlData);
-    
-    switch(yxmlState)
-    {
-      case YXML_ATTRVAL:
-      case YXML_CONTENT:
-	switch(g_parserData.yxml.data[0])
-	{
-	  case '\n':
-	  case '>':
-	  case '<':
-	    break;
-	  default:
-	    g_parserData.stringBuffer[index] = g_parserData.yxml.data[0];
-	    
-	    index++;
-	    
-	    if(index >= 256)
+	    if(p_primParam->p_texture == NULL)
 	    {
+	      printf("BAD ALLOC\n");
+	      free(p_primParam);
 	      return -1;
 	    }
-	    break;
+
+	    g_parserData.textureDepth = g_parserData.depth + 1;
+	  }
 	}
+
+	g_parserData.depth++;
+	g_parserData.stringIndex = 0;
+	memset(g_parserData.stringBuffer, 0, 256);
+	break;
+      case YXML_ATTRSTART:
+	g_parserData.stringIndex = 0;
+	memset(g_parserData.stringBuffer, 0, 256);
+	break;
+      case YXML_ATTRVAL:
+      case YXML_CONTENT:
+	addXMLcontent();
 	break;
       case YXML_ATTREND:
+	//only the prim element carries the type
+	if((g_parserData.depth == baseDepth + 1) && (strcmp(g_parserData.yxml.attr, XML_TYPE_NAME) == 0))
+	{
+	  setPrimType(p_primParam);
+	}
+	break;
       case YXML_ELEMEND:
-	return 0;
+	if(g_parserData.depth <= MAX_TAG_DEPTH)
+	{
+	  setPrimField(p_primParam);
+	}
+
+	if(g_parserData.depth == g_parserData.textureDepth)
+	{
+	  g_parserData.textureDepth = 0;
+	}
+
+	g_parserData.depth--;
 	break;
       default:
 	break;
     }
-    
-    g_parserData.p_xmlData++;
+
+    //prim element closed, done with this prim
+    if((yxmlState == YXML_ELEMEND) && (g_parserData.depth == baseDepth))
+    {
+      returnValue = 1;
+      break;
+    }
   }
-  while(*g_parserData.p_xmlData);
-    
-  return -1;
+
+  if(p_primParam == NULL)
+  {
+    return returnValue;
+  }
+
+  //a file broken after the needed fields still loads, the caller stops on the -1
+  *op_primParam = (checkPrim(p_primParam) < 0 ? NULL : p_primParam);
+
+  return returnValue;
 }
 
-//find vertex data, helps since this needs to happen 4 or more times
-int findSVertex(struct s_svertex *p_vertex, char const * const p_vertexName)
+//check the required fields were found and finish the prim, frees it and returns -1 if not
+int checkPrim(struct s_primParam *p_primParam)
 {
-  if(findXMLblock(p_vertexName) < 0)
+  if(!(g_parserData.found & FOUND_TYPE))
   {
-    resetXMLstart();
+    printf("DID NOT FIND TYPE NAME\n");
+    freePrimData(&p_primParam);
     return -1;
   }
- 
-  setXMLblock();
- 
-  if(findXMLelem(XML_X_CORR) < 0)
+
+  if(!(g_parserData.found & FOUND_VERTEX0))
   {
-    resetXMLstart();
+    printf("COULD NOT FIND VERTEX 0\n");
+    freePrimData(&p_primParam);
     return -1;
   }
-  
-  p_vertex->vx = atoi(g_parserData.stringBuffer);
-  
-  resetXMLblock();
-  
-  if(findXMLelem(XML_Y_CORR) < 0)
+
+  if(!(g_parserData.found & FOUND_COLOR0))
   {
-    resetXMLstart();
+    printf("COULD NOT FIND COLOR 0\n");
+    freePrimData(&p_primParam);
     return -1;
   }
-  
-  p_vertex->vy = atoi(g_parserData.stringBuffer);
-  
-  resetXMLstart();
-  
-  return 0;
-}
 
-//find vertex data, helps since this needs to happen 4 or more times
-int findLVertex(struct s_lvertex *p_vertex, char const * const p_vertexName)
-{
-  if(findXMLblock(p_vertexName) < 0)
+  if(!(g_parserData.found & FOUND_WIDTH))
   {
-    resetXMLstart();
+    printf("COULD NOT FIND WIDTH\n");
+    freePrimData(&p_primParam);
     return -1;
   }
- 
-  setXMLblock();
- 
-  if(findXMLelem(XML_X_CORR) < 0)
+
+  if(!(g_parserData.found & FOUND_HEIGHT))
   {
-    resetXMLstart();
+    printf("COULD NOT FIND HEIGHT\n");
+    freePrimData(&p_primParam);
     return -1;
   }
-  
-  p_vertex->vx = atoi(g_parserData.stringBuffer);
-  
-  resetXMLblock();
-  
-  if(findXMLelem(XML_Y_CORR) < 0)
+
+  p_primParam->vertex0.vx = -(p_primParam->dimensions.w/2);
+  p_primParam->vertex0.vy = -(p_primParam->dimensions.h/2);
+
+  if(p_primParam->p_texture != NULL)
   {
-    resetXMLstart();
-    return -1;
+    if(!(g_parserData.found & FOUND_TVERTEX0))
+    {
+      printf("COULD NOT FIND VERTEX 0\n");
+      freePrimData(&p_primParam);
+      return -1;
+    }
+
+    if(!(g_parserData.found & FOUND_VRAM))
+    {
+      printf("COULD NOT FIND VRAM\n");
+      freePrimData(&p_primParam);
+      return -1;
+    }
+
+    if((g_parserData.found & (FOUND_TWIDTH | FOUND_THEIGHT | FOUND_FILE)) != (FOUND_TWIDTH | FOUND_THEIGHT | FOUND_FILE))
+    {
+      printf("COULD NOT FIND TEXTURE SIZE OR FILE\n");
+      freePrimData(&p_primParam);
+      return -1;
+    }
   }
-  
-  p_vertex->vy = atoi(g_parserData.stringBuffer);
-  
-  resetXMLstart();
-  
+
   return 0;
 }
 
-//find color data, helps since this happens 4 or more times
-int findColor(struct s_color *color, char const * const p_colorName)
+//find the tag for a element name
+enum en_xmlTag findXMLtag(char const * const p_elem)
 {
-  if(findXMLblock(p_colorName) < 0)
-  {
-    resetXMLstart();
-    return -1;
-  }
- 
-  setXMLblock();
- 
-  if(findXMLelem(XML_RED) < 0)
+  int index;
+
+  for(index = 0; strcmp(gc_xmlTag[index], "END") != 0; index++)
   {
-    resetXMLstart();
-    return -1;
+    if(strcmp(gc_xmlTag[index], p_elem) == 0)
+    {
+      return (enum en_xmlTag)index;
+    }
   }
-  
-  color->r = atoi(g_parserData.stringBuffer);
-  
-  resetXMLblock();
-  
-  if(findXMLelem(XML_GREEN) < 0)
+
+  return TAG_OTHER;
+}
+
+//add content from a element or attribute, yxml hands over one byte (or a reference) per call
+int addXMLcontent()
+{
+  char const *p_data;
+
+  for(p_data = g_parserData.yxml.data; *p_data; p_data++)
   {
-    resetXMLstart();
-    return -1;
+    switch(*p_data)
+    {
+      case '\n':
+      case '>':
+      case '<':
+	break;
+      default:
+	//keep the last byte for the terminator
+	if(g_parserData.stringIndex >= 255)
+	{
+	  return -1;
+	}
+
+	g_parserData.stringBuffer[g_parserData.stringIndex] = *p_data;
+
+	g_parserData.stringIndex++;
+	break;
+    }
   }
-  
-  color->g = atoi(g_parserData.stringBuffer);
-  
-  resetXMLblock();
-  
-  if(findXMLelem(XML_BLUE) < 0)
+
+  return 0;
+}
+
+//element closed, the stack top is the element and the one below it is its parent
+void setPrimField(struct s_primParam *p_primParam)
+{
+  int value;
+  enum en_xmlTag tag;
+  enum en_xmlTag parent;
+  struct s_texture *p_texture;
+  struct s_color *p_color = NULL;
+
+  tag = g_parserData.tagStack[g_parserData.depth - 1];
+  parent = (g_parserData.depth > 1 ? g_parserData.tagStack[g_parserData.depth - 2] : TAG_OTHER);
+
+  //inside the texture block with one allocated
+  p_texture = (g_parserData.textureDepth > 0 ? p_primParam->p_texture : NULL);
+
+  value = atoi(g_parserData.stringBuffer);
+
+  switch(tag)
   {
-    resetXMLstart();
-    return -1;
+    case TAG_X_CORR:
+    case TAG_Y_CORR:
+      if((p_texture != NULL) && (parent == TAG_VERTEX_0))
+      {
+	if(tag == TAG_X_CORR)
+	{
+	  p_texture->vertex0.vx = value;
+	}
+	else
+	{
+	  p_texture->vertex0.vy = value;
+	  g_parserData.found |= FOUND_TVERTEX0;
+	}
+      }
+      else if((p_texture != NULL) && (parent == TAG_VRAM))
+      {
+	if(tag == TAG_X_CORR)
+	{
+	  p_texture->vramVertex.vx = value;
+	}
+	else
+	{
+	  p_texture->vramVertex.vy = value;
+	  g_parserData.found |= FOUND_VRAM;
+	}
+      }
+      else if((p_texture == NULL) && (parent == TAG_VERTEX_0))
+      {
+	if(tag == TAG_X_CORR)
+	{
+	  p_primParam->transCoor.vx = value;
+	}
+	else
+	{
+	  p_primParam->transCoor.vy = value;
+	  g_parserData.found |= FOUND_VERTEX0;
+	}
+      }
+      break;
+    case TAG_RED:
+    case TAG_GREEN:
+    case TAG_BLUE:
+      switch(parent)
+      {
+	case TAG_COLOR_0:
+	  p_color = &p_primParam->color0;
+	  break;
+	case TAG_COLOR_1:
+	  p_color = &p_primParam->color1;
+	  break;
+	case TAG_COLOR_2:
+	  p_color = &p_primParam->color2;
+	  break;
+	case TAG_COLOR_3:
+	  p_color = &p_primParam->color3;
+	  break;
+	default:
+	  break;
+      }
+
+      if(p_color == NULL)
+      {
+	break;
+      }
+
+      if(tag == TAG_RED)
+      {
+	p_color->r = value;
+      }
+      else if(tag == TAG_GREEN)
+      {
+	p_color->g = value;
+      }
+      else
+      {
+	p_color->b = value;
+	g_parserData.found |= (parent == TAG_COLOR_0 ? FOUND_COLOR0 : 0);
+      }
+      break;
+    case TAG_WIDTH:
+      p_primParam->dimensions.w = value;
+      g_parserData.found |= FOUND_WIDTH;
+      break;
+    case TAG_HEIGHT:
+      p_primParam->dimensions.h = value;
+      g_parserData.found |= FOUND_HEIGHT;
+      break;
+    case TAG_TWIDTH:
+      if(p_texture != NULL)
+      {
+	p_texture->dimensions.w = value;
+	g_parserData.found |= FOUND_TWIDTH;
+      }
+      break;
+    case TAG_THEIGHT:
+      if(p_texture != NULL)
+      {
+	p_texture->dimensions.h = value;
+	g_parserData.found |= FOUND_THEIGHT;
+      }
+      break;
+    case TAG_FILE:
+      if(p_texture != NULL)
+      {
+	strcpy(p_texture->file, g_parserData.stringBuffer);
+	g_parserData.found |= FOUND_FILE;
+      }
+      break;
+    default:
+      break;
   }
-  
-  color->b = atoi(g_parserData.stringBuffer);
-  
-  resetXMLstart();
-  
-  return 0;
 }
 
-//set xml block pointer to current spot
-void setXMLblock()
+//set type from the attribute value, unknown names leave it at the first type
+void setPrimType(struct s_primParam *p_primParam)
 {
-  g_parserData.p_xmlDataBlock = g_parserData.p_xmlData;
+  int index;
+
+  for(index = 0; strcmp(gc_primType[index], "END") != 0; index++)
+  {
+    if(strcmp(gc_primType[index], g_parserData.stringBuffer) == 0)
+    {
+      p_primParam->type = (enum en_primType)index;
+      break;
+    }
+  }
+
+  g_parserData.found |= FOUND_TYPE;
 }
 
 //reset current pointer to start of xml data
 void resetXMLstart()
 { 
   setXMLdata(g_parserData.p_xmlDataStart);
-}
-
-//reset current pointer back to last setXMLblock call
-void resetXMLblock()
-{
-  g_parserData.p_xmlData = g_parserData.p_xmlDataBlock;
 }
\ No newline at end of file
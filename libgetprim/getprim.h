@@ -10,9 +10,9 @@
  * Note: They only mallocs are for the s_primParam, and the texture struct inside, the data pointer inside
  * the texture struct is NOT allocated by this library.
  *
- * This library is written to parse over and over the xml, so elements do
- * not need to be in order, but missing elements can cause unforseen results.
- * Malformed files are not checked at this time (probably result in null output anyways).
+ * This library parses the xml in a single pass, tracking the element stack so elements do
+ * not need to be in order. Missing required elements return NULL, parsing stops at the
+ * first yxml error and keeps whatever was read before it.
  * 
  */
 
@@ -36,5 +36,12 @@ void setXMLdata(char const *p_xmlData);
 //parse the data
 struct s_primParam *getPrimData();
 
+//parse a scene, a SCENE root holding many prims, into op_primParam (up to maxPrim). returns number of prims or -1.
+//slots of prims missing required elements are NULL so indexes follow the file order
+int getSceneData(struct s_primParam **op_primParam, int maxPrim);
+
+//number of bytes fed to yxml by the last getPrimData or getSceneData call
+int getPrimDataBytes();
+
 
 #endif // GETPRIM_H
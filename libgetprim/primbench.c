@@ -0,0 +1,537 @@
+/*
+ * Host benchmark for libgetprim, runs the single pass getPrimData and the old parser (kept below, it
+ * rescanned the xml from the start for every field) over xml files and prints bytes fed to yxml and
+ * time per object for both, plus a check that both read the same values.
+ *
+ * Built with make HOST_BUILD, run with make bench or ./primbench [-n iterations] file.xml ...
+ *
+ */
+#include "getprim.h"
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <yxml.h>
+
+#define DEFAULT_BUFSIZE 2048
+#define DEFAULT_ITERATIONS 10000
+
+//state of the old parser
+struct
+{
+  int bufSize;
+  int bytesParsed;
+  char stringBuffer[256];
+
+  yxml_t yxml;
+
+  char p_stack[DEFAULT_BUFSIZE];
+  char const *p_xmlData;
+  char const *p_xmlDataBlock;
+  char const *p_xmlDataStart;
+
+} g_rescanData;
+
+//old parser helpers, same as they were in getprim.c
+int rescanAttr(char const * const p_attr);
+int rescanElem(char const * const p_elem);
+int rescanBlock(char const * const p_block);
+int rescanContent();
+int rescanLVertex(struct s_lvertex *p_vertex, char const * const p_vertexName);
+int rescanSVertex(struct s_svertex *p_vertex, char const * const p_vertexName);
+int rescanColor(struct s_color *color, char const * const p_colorName);
+
+//feed one byte to yxml and count it
+yxml_ret_t rescanParse()
+{
+  g_rescanData.bytesParsed++;
+
+  return yxml_parse(&g_rescanData.yxml, *g_rescanData.p_xmlData);
+}
+
+//reset old parser for a new document
+void rescanReset(char const *p_xmlData)
+{
+  memset(&g_rescanData, 0, sizeof(g_rescanData));
+
+  g_rescanData.bufSize = DEFAULT_BUFSIZE;
+  g_rescanData.p_xmlData = p_xmlData;
+  g_rescanData.p_xmlDataStart = p_xmlData;
+
+  yxml_init(&g_rescanData.yxml, g_rescanData.p_stack, g_rescanData.bufSize);
+}
+
+//old getPrimData, every field search starts over from the top of the data
+struct s_primParam *rescanPrimData()
+{
+  int index;
+  char const * const primType[] = {"TYPE_F4", "TYPE_FT4", "TYPE_G4", "TYPE_GT4", "TYPE_SPRITE", "TYPE_TILE", "END"};
+
+  struct s_primParam *p_primParam;
+
+  p_primParam = calloc(1, sizeof(*p_primParam));
+
+  if(p_primParam == NULL)
+  {
+    return NULL;
+  }
+
+  if(rescanAttr("type") < 0)
+  {
+    free(p_primParam);
+    return NULL;
+  }
+
+  for(index = 0; strcmp(primType[index], "END") != 0; index++)
+  {
+    if(strcmp(primType[index], g_rescanData.stringBuffer) == 0)
+    {
+      p_primParam->type = (enum en_primType)index;
+      break;
+    }
+  }
+
+  if((rescanLVertex(&p_primParam->transCoor, "vertex0") < 0) || (rescanColor(&p_primParam->color0, "color0") < 0))
+  {
+    free(p_primParam);
+    return NULL;
+  }
+
+  rescanColor(&p_primParam->color1, "color1");
+  rescanColor(&p_primParam->color1, "color2");
+  rescanColor(&p_primParam->color1, "color3");
+
+  if(rescanElem("width") < 0)
+  {
+    free(p_primParam);
+    return NULL;
+  }
+
+  p_primParam->dimensions.w = atoi(g_rescanData.stringBuffer);
+
+  g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+
+  if(rescanElem("height") < 0)
+  {
+    free(p_primParam);
+    return NULL;
+  }
+
+  p_primParam->dimensions.h = atoi(g_rescanData.stringBuffer);
+
+  p_primParam->vertex0.vx = -(p_primParam->dimensions.w/2);
+  p_primParam->vertex0.vy = -(p_primParam->dimensions.h/2);
+
+  g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+
+  if(rescanBlock("texture") == 0)
+  {
+    g_rescanData.p_xmlDataBlock = g_rescanData.p_xmlData;
+
+    p_primParam->p_texture = calloc(1, sizeof(*p_primParam->p_texture));
+
+    if(p_primParam->p_texture == NULL)
+    {
+      free(p_primParam);
+      return NULL;
+    }
+
+    if(rescanSVertex(&p_primParam->p_texture->vertex0, "vertex0") < 0)
+    {
+      freePrimData(&p_primParam);
+      return NULL;
+    }
+
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataBlock;
+
+    if(rescanSVertex(&p_primParam->p_texture->vramVertex, "vramVertex") < 0)
+    {
+      freePrimData(&p_primParam);
+      return NULL;
+    }
+
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataBlock;
+
+    if(rescanElem("twidth") < 0)
+    {
+      freePrimData(&p_primParam);
+      return NULL;
+    }
+
+    p_primParam->p_texture->dimensions.w = atoi(g_rescanData.stringBuffer);
+
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataBlock;
+
+    if(rescanElem("theight") < 0)
+    {
+      freePrimData(&p_primParam);
+      return NULL;
+    }
+
+    p_primParam->p_texture->dimensions.h = atoi(g_rescanData.stringBuffer);
+
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataBlock;
+
+    if(rescanElem("file") < 0)
+    {
+      freePrimData(&p_primParam);
+      return NULL;
+    }
+
+    strcpy(p_primParam->p_texture->file, g_rescanData.stringBuffer);
+  }
+
+  return p_primParam;
+}
+
+//old attribute search
+int rescanAttr(char const * const p_attr)
+{
+  do
+  {
+    if((rescanParse() == YXML_ATTRSTART) && (strcmp(g_rescanData.yxml.attr, p_attr) == 0))
+    {
+      return rescanContent();
+    }
+
+    g_rescanData.p_xmlData++;
+  }
+  while(*g_rescanData.p_xmlData);
+
+  return -1;
+}
+
+//old element search
+int rescanElem(char const * const p_elem)
+{
+  do
+  {
+    if((rescanParse() == YXML_ELEMSTART) && (strcmp(g_rescanData.yxml.elem, p_elem) == 0))
+    {
+      return rescanContent();
+    }
+
+    g_rescanData.p_xmlData++;
+  }
+  while(*g_rescanData.p_xmlData);
+
+  return -1;
+}
+
+//old block search
+int rescanBlock(char const * const p_block)
+{
+  do
+  {
+    if((rescanParse() == YXML_ELEMSTART) && (strcmp(g_rescanData.yxml.elem, p_block) == 0))
+    {
+      return 0;
+    }
+
+    g_rescanData.p_xmlData++;
+  }
+  while(*g_rescanData.p_xmlData);
+
+  return -1;
+}
+
+//old content read
+int rescanContent()
+{
+  int index = 0;
+
+  memset(g_rescanData.stringBuffer, 0, 256);
+
+  do
+  {
+    switch(rescanParse())
+    {
+      case YXML_ATTRVAL:
+      case YXML_CONTENT:
+	switch(g_rescanData.yxml.data[0])
+	{
+	  case '\n':
+	  case '>':
+	  case '<':
+	    break;
+	  default:
+	    g_rescanData.stringBuffer[index] = g_rescanData.yxml.data[0];
+
+	    index++;
+
+	    if(index >= 256)
+	    {
+	      return -1;
+	    }
+	    break;
+	}
+	break;
+      case YXML_ATTREND:
+      case YXML_ELEMEND:
+	return 0;
+      default:
+	break;
+    }
+
+    g_rescanData.p_xmlData++;
+  }
+  while(*g_rescanData.p_xmlData);
+
+  return -1;
+}
+
+//old short vertex search
+int rescanSVertex(struct s_svertex *p_vertex, char const * const p_vertexName)
+{
+  struct s_lvertex vertex;
+
+  if(rescanLVertex(&vertex, p_vertexName) < 0)
+  {
+    return -1;
+  }
+
+  p_vertex->vx = vertex.vx;
+  p_vertex->vy = vertex.vy;
+
+  return 0;
+}
+
+//old long vertex search, x and y each rescan from the vertex block
+int rescanLVertex(struct s_lvertex *p_vertex, char const * const p_vertexName)
+{
+  if(rescanBlock(p_vertexName) < 0)
+  {
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+    return -1;
+  }
+
+  g_rescanData.p_xmlDataBlock = g_rescanData.p_xmlData;
+
+  if(rescanElem("x") < 0)
+  {
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+    return -1;
+  }
+
+  p_vertex->vx = atoi(g_rescanData.stringBuffer);
+
+  g_rescanData.p_xmlData = g_rescanData.p_xmlDataBlock;
+
+  if(rescanElem("y") < 0)
+  {
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+    return -1;
+  }
+
+  p_vertex->vy = atoi(g_rescanData.stringBuffer);
+
+  g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+
+  return 0;
+}
+
+//old color search, one rescan per channel
+int rescanColor(struct s_color *color, char const * const p_colorName)
+{
+  int index;
+  uint8_t *p_channel[3];
+  char const * const channel[] = {"red", "green", "blue"};
+
+  p_channel[0] = &color->r;
+  p_channel[1] = &color->g;
+  p_channel[2] = &color->b;
+
+  if(rescanBlock(p_colorName) < 0)
+  {
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+    return -1;
+  }
+
+  g_rescanData.p_xmlDataBlock = g_rescanData.p_xmlData;
+
+  for(index = 0; index < 3; index++)
+  {
+    g_rescanData.p_xmlData = g_rescanData.p_xmlDataBlock;
+
+    if(rescanElem(channel[index]) < 0)
+    {
+      g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+      return -1;
+    }
+
+    *p_channel[index] = atoi(g_rescanData.stringBuffer);
+  }
+
+  g_rescanData.p_xmlData = g_rescanData.p_xmlDataStart;
+
+  return 0;
+}
+
+//compare what both parsers read, color1 to 3 are left out since the old parser put them all in color1
+int comparePrim(struct s_primParam *p_old, struct s_primParam *p_new)
+{
+  if((p_old == NULL) || (p_new == NULL))
+  {
+    return (p_old == p_new ? 0 : -1);
+  }
+
+  if((p_old->type != p_new->type) || (p_old->transCoor.vx != p_new->transCoor.vx) || (p_old->transCoor.vy != p_new->transCoor.vy))
+  {
+    return -1;
+  }
+
+  if((p_old->dimensions.w != p_new->dimensions.w) || (p_old->dimensions.h != p_new->dimensions.h))
+  {
+    return -1;
+  }
+
+  if(memcmp(&p_old->color0, &p_new->color0, sizeof(p_old->color0)) != 0)
+  {
+    return -1;
+  }
+
+  if((p_old->p_texture == NULL) || (p_new->p_texture == NULL))
+  {
+    return (p_old->p_texture == p_new->p_texture ? 0 : -1);
+  }
+
+  if(memcmp(&p_old->p_texture->vertex0, &p_new->p_texture->vertex0, sizeof(p_old->p_texture->vertex0)) != 0)
+  {
+    return -1;
+  }
+
+  if(memcmp(&p_old->p_texture->vramVertex, &p_new->p_texture->vramVertex, sizeof(p_old->p_texture->vramVertex)) != 0)
+  {
+    return -1;
+  }
+
+  if((p_old->p_texture->dimensions.w != p_new->p_texture->dimensions.w) || (p_old->p_texture->dimensions.h != p_new->p_texture->dimensions.h))
+  {
+    return -1;
+  }
+
+  return strcmp(p_old->p_texture->file, p_new->p_texture->file);
+}
+
+//read a whole file into a null terminated buffer
+char *readFile(char const *p_fileName)
+{
+  long size;
+  char *p_buff;
+  FILE *p_file;
+
+  p_file = fopen(p_fileName, "rb");
+
+  if(p_file == NULL)
+  {
+    return NULL;
+  }
+
+  fseek(p_file, 0, SEEK_END);
+  size = ftell(p_file);
+  fseek(p_file, 0, SEEK_SET);
+
+  p_buff = calloc(1, size + 1);
+
+  if((p_buff != NULL) && (fread(p_buff, 1, size, p_file) != (size_t)size))
+  {
+    free(p_buff);
+    p_buff = NULL;
+  }
+
+  fclose(p_file);
+
+  return p_buff;
+}
+
+int main(int argc, char *argv[])
+{
+  int index;
+  int iter;
+  int iterations = DEFAULT_ITERATIONS;
+  int first = 1;
+  int oldBytes;
+  int newBytes;
+  long totalOld = 0;
+  long totalNew = 0;
+  double oldTime;
+  double newTime;
+  double totalOldTime = 0;
+  double totalNewTime = 0;
+  clock_t start;
+  char *p_buff;
+  struct s_primParam *p_old = NULL;
+  struct s_primParam *p_new = NULL;
+
+  if((argc > 2) && (strcmp(argv[1], "-n") == 0))
+  {
+    iterations = atoi(argv[2]);
+    first = 3;
+  }
+
+  if((first >= argc) || (iterations <= 0))
+  {
+    printf("usage: %s [-n iterations] file.xml ...\n", argv[0]);
+    return 1;
+  }
+
+  initGetPrimData();
+
+  printf("%-28s %8s %8s %10s %10s %s\n", "FILE", "OLD B", "NEW B", "OLD US", "NEW US", "CHECK");
+
+  for(index = first; index < argc; index++)
+  {
+    p_buff = readFile(argv[index]);
+
+    if(p_buff == NULL)
+    {
+      printf("%-28s COULD NOT READ\n", argv[index]);
+      continue;
+    }
+
+    start = clock();
+
+    for(iter = 0; iter < iterations; iter++)
+    {
+      freePrimData(&p_old);
+
+      rescanReset(p_buff);
+
+      p_old = rescanPrimData();
+    }
+
+    oldTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+    oldBytes = g_rescanData.bytesParsed;
+
+    start = clock();
+
+    for(iter = 0; iter < iterations; iter++)
+    {
+      freePrimData(&p_new);
+
+      setXMLdata(p_buff);
+
+      p_new = getPrimData();
+
+      resetGetPrimData();
+    }
+
+    newTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+    newBytes = getPrimDataBytes();
+
+    printf("%-28s %8d %8d %10.2f %10.2f %s\n", argv[index], oldBytes, newBytes, oldTime * 1000000 / iterations, newTime * 1000000 / iterations, (comparePrim(p_old, p_new) == 0 ? "MATCH" : "DIFF"));
+
+    totalOld += oldBytes;
+    totalNew += newBytes;
+    totalOldTime += oldTime;
+    totalNewTime += newTime;
+
+    freePrimData(&p_old);
+    freePrimData(&p_new);
+
+    free(p_buff);
+  }
+
+  printf("%-28s %8ld %8ld %10.2f %10.2f\n", "TOTAL", totalOld, totalNew, totalOldTime * 1000000 / iterations, totalNewTime * 1000000 / iterations);
+
+  return 0;
+}
@@ -0,0 +1,288 @@
+/*
+ * Host compiler for binary scenes, reads prim or scene xml files with libgetprim and writes one binary
+ * scene (s_primBinHeader, s_primBinRecord in ENGTYP.h) that getSceneBin copies straight into s_primParam.
+ *
+ * Fields are written a byte at a time little endian so the output is the same on any host.
+ * Texture file names go in a string table once each, records point at them by offset.
+ *
+ * Built with make HOST_BUILD, run as ./primc out.bin file.xml ...
+ *
+ */
+#include "getprim.h"
+#include <string.h>
+#include <stdio.h>
+
+//most prims one binary scene can hold (count is 16 bits)
+#define MAX_PRIMS 1024
+//string table size, offsets are 16 bits
+#define MAX_STRINGS 0xFFFF
+
+//holds the prims and strings being compiled
+struct
+{
+  int count;
+  struct s_primParam *p_primParam[MAX_PRIMS];
+
+  int stringSize;
+  char strings[MAX_STRINGS];
+
+} g_compileData;
+
+//write 8, 16 and 32 bit little endian values
+void putU8(FILE *p_file, uint32_t value)
+{
+  fputc(value & 0xFF, p_file);
+}
+
+void putU16(FILE *p_file, uint32_t value)
+{
+  putU8(p_file, value);
+  putU8(p_file, value >> 8);
+}
+
+void putU32(FILE *p_file, uint32_t value)
+{
+  putU16(p_file, value);
+  putU16(p_file, value >> 16);
+}
+
+//add a string to the table once, returns its offset or -1 if the table is full
+int addString(char const *p_string)
+{
+  int offset;
+  int len;
+
+  //same file name in many prims is stored once
+  for(offset = 0; offset < g_compileData.stringSize; offset += strlen(g_compileData.strings + offset) + 1)
+  {
+    if(strcmp(g_compileData.strings + offset, p_string) == 0)
+    {
+      return offset;
+    }
+  }
+
+  len = strlen(p_string) + 1;
+
+  if((g_compileData.stringSize + len) > MAX_STRINGS)
+  {
+    return -1;
+  }
+
+  offset = g_compileData.stringSize;
+
+  memcpy(g_compileData.strings + offset, p_string, len);
+
+  g_compileData.stringSize += len;
+
+  return offset;
+}
+
+//read a whole file into a null terminated buffer
+char *readFile(char const *p_fileName)
+{
+  long size;
+  char *p_buff;
+  FILE *p_file;
+
+  p_file = fopen(p_fileName, "rb");
+
+  if(p_file == NULL)
+  {
+    return NULL;
+  }
+
+  fseek(p_file, 0, SEEK_END);
+  size = ftell(p_file);
+  fseek(p_file, 0, SEEK_SET);
+
+  p_buff = calloc(1, size + 1);
+
+  if((p_buff != NULL) && (fread(p_buff, 1, size, p_file) != (size_t)size))
+  {
+    free(p_buff);
+    p_buff = NULL;
+  }
+
+  fclose(p_file);
+
+  return p_buff;
+}
+
+//parse one xml file, a scene or a single prim, and add its prims. returns number added or -1
+int addXMLfile(char const *p_fileName)
+{
+  int count;
+  char *p_buff;
+
+  p_buff = readFile(p_fileName);
+
+  if(p_buff == NULL)
+  {
+    printf("COULD NOT READ %s\n", p_fileName);
+    return -1;
+  }
+
+  setXMLdata(p_buff);
+
+  if(strstr(p_buff, "<SCENE") != NULL)
+  {
+    count = getSceneData(&g_compileData.p_primParam[g_compileData.count], MAX_PRIMS - g_compileData.count);
+  }
+  else if(g_compileData.count < MAX_PRIMS)
+  {
+    g_compileData.p_primParam[g_compileData.count] = getPrimData();
+    count = (g_compileData.p_primParam[g_compileData.count] != NULL ? 1 : -1);
+  }
+  else
+  {
+    count = -1;
+  }
+
+  resetGetPrimData();
+
+  free(p_buff);
+
+  if(count < 0)
+  {
+    printf("COULD NOT PARSE %s\n", p_fileName);
+    return -1;
+  }
+
+  g_compileData.count += count;
+
+  return count;
+}
+
+//write one record, same field order and widths as s_primBinRecord
+int writeRecord(FILE *p_file, struct s_primParam *p_primParam)
+{
+  int index;
+  int offset = 0;
+  struct s_texture empty;
+  struct s_texture *p_texture = p_primParam->p_texture;
+  struct s_color *p_color[4];
+
+  p_color[0] = &p_primParam->color0;
+  p_color[1] = &p_primParam->color1;
+  p_color[2] = &p_primParam->color2;
+  p_color[3] = &p_primParam->color3;
+
+  //already in the table, this only looks up the offset
+  if(p_texture != NULL)
+  {
+    offset = addString(p_texture->file);
+  }
+  else
+  {
+    memset(&empty, 0, sizeof(empty));
+    p_texture = &empty;
+  }
+
+  if((p_primParam->dimensions.w > 0xFFFF) || (p_primParam->dimensions.h > 0xFFFF))
+  {
+    printf("DIMENSIONS TOO LARGE\n");
+    return -1;
+  }
+
+  putU8(p_file, p_primParam->type);
+  putU8(p_file, (p_primParam->p_texture != NULL ? PRIM_BIN_TEXTURE : 0));
+  putU16(p_file, offset);
+  putU32(p_file, p_primParam->transCoor.vx);
+  putU32(p_file, p_primParam->transCoor.vy);
+  putU16(p_file, p_primParam->dimensions.w);
+  putU16(p_file, p_primParam->dimensions.h);
+
+  for(index = 0; index < 4; index++)
+  {
+    putU8(p_file, p_color[index]->r);
+    putU8(p_file, p_color[index]->g);
+    putU8(p_file, p_color[index]->b);
+  }
+
+  putU16(p_file, p_texture->vertex0.vx);
+  putU16(p_file, p_texture->vertex0.vy);
+  putU16(p_file, p_texture->vramVertex.vx);
+  putU16(p_file, p_texture->vramVertex.vy);
+  putU16(p_file, p_texture->dimensions.w);
+  putU16(p_file, p_texture->dimensions.h);
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int index;
+  FILE *p_file;
+
+  if(argc < 3)
+  {
+    printf("usage: %s out.bin file.xml ...\n", argv[0]);
+    return 1;
+  }
+
+  memset(&g_compileData, 0, sizeof(g_compileData));
+
+  initGetPrimData();
+
+  for(index = 2; index < argc; index++)
+  {
+    if(addXMLfile(argv[index]) < 0)
+    {
+      return 1;
+    }
+  }
+
+  //file order is kept, a prim that failed its checks has no record to leave a gap with.
+  //texture names go in the table first so the header has its size
+  for(index = 0; index < g_compileData.count; index++)
+  {
+    if(g_compileData.p_primParam[index] == NULL)
+    {
+      printf("PRIM %d FAILED TO PARSE\n", index);
+      return 1;
+    }
+
+    if((g_compileData.p_primParam[index]->p_texture != NULL) && (addString(g_compileData.p_primParam[index]->p_texture->file) < 0))
+    {
+      printf("STRING TABLE FULL\n");
+      return 1;
+    }
+  }
+
+  p_file = fopen(argv[1], "wb");
+
+  if(p_file == NULL)
+  {
+    printf("COULD NOT OPEN %s\n", argv[1]);
+    return 1;
+  }
+
+  putU32(p_file, PRIM_BIN_MAGIC);
+  putU16(p_file, PRIM_BIN_VERSION);
+  putU16(p_file, g_compileData.count);
+  putU16(p_file, sizeof(struct s_primBinRecord));
+  putU16(p_file, 0);
+  putU32(p_file, g_compileData.stringSize);
+
+  for(index = 0; index < g_compileData.count; index++)
+  {
+    if(writeRecord(p_file, g_compileData.p_primParam[index]) < 0)
+    {
+      fclose(p_file);
+      return 1;
+    }
+  }
+
+  fwrite(g_compileData.strings, 1, g_compileData.stringSize, p_file);
+
+  fclose(p_file);
+
+  printf("%s: %d prims, %d string bytes, %d bytes\n", argv[1], g_compileData.count, g_compileData.stringSize, (int)(sizeof(struct s_primBinHeader) + g_compileData.count * sizeof(struct s_primBinRecord) + g_compileData.stringSize));
+
+  for(index = 0; index < g_compileData.count; index++)
+  {
+    freePrimData(&g_compileData.p_primParam[index]);
+  }
+
+  return 0;
+}
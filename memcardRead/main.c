@@ -12,7 +12,7 @@ int main()
   char *p_title = "Memory Card Read Example\nREAD:";
   struct s_environment environment;
   
-  initEnv(&environment, 0);
+  initEnv(&environment, 0, 1, DOUBLE_BUF);
   
   environment.envMessage.p_title = p_title;
   environment.envMessage.p_message = memoryCardRead(128);
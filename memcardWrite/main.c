@@ -14,7 +14,7 @@ int main()
   int len = 0;
   struct s_environment environment;
   
-  initEnv(&environment, 0);
+  initEnv(&environment, 0, 1, DOUBLE_BUF);
   
   len = strlen(p_message);
   
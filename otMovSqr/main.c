@@ -17,7 +17,7 @@ int main()
   char *p_title = "Ordering Table Example\nMoving Square";
   struct s_environment environment;
   
-  initEnv(&environment, 6);
+  initEnv(&environment, 6, 0, DOUBLE_BUF);
 
   createGameObjects(&environment);
   
@@ -27,10 +27,14 @@ int main()
   
   populateOT(&environment);
 
+  //move the selected primitive every tick
+  addJob(&environment, movPrim, 1);
+
   for(;;)
   {
     display(&environment);
-    movPrim(&environment);
+    runJobs(&environment);
+    updatePrim(&environment);
   }
 
   return 0;
@@ -40,12 +44,11 @@ int main()
 void createGameObjects(struct s_environment *p_env)
 {
   int index;
-  int buffIndex;
   
   //list of file names
   char *fileNames[] = {"\\SQ1.XML;1", "\\SQ2.XML;1", "\\SQ3.XML;1", "\\SQ4.XML;1", "\\SQ5.XML;1", "\\SQ6.XML;1"};
   
-  for(index = 0; index < p_env->otSize; index++)
+  for(index = 0; index < p_env->primSize; index++)
   {
     //go through the list and get the object info
     p_env->p_primParam[index] = getObjects(fileNames[index]);
@@ -56,12 +59,6 @@ void createGameObjects(struct s_environment *p_env)
       p_env->p_primParam[index]->color0.r = rand() % 256;
       p_env->p_primParam[index]->color0.g = rand() % 256;
       p_env->p_primParam[index]->color0.b = rand() % 256;
-      
-      //create a primitive in each buffer for each object
-      for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
-      {
-	p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(POLY_F4));
-      }
     }
   }
 }
\ No newline at end of file
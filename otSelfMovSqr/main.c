@@ -21,7 +21,7 @@ int main()
   char *p_title = "Ordering Table Example\nAtari Attack";
   struct s_environment environment;
   
-  initEnv(&environment, 2);
+  initEnv(&environment, 2, 0, DOUBLE_BUF);
 
   createGameObjects(&environment);
   
@@ -46,23 +46,13 @@ int main()
 void createGameObjects(struct s_environment *p_env)
 {
   int index;
-  int buffIndex;
   //list of files to read
   char *fileNames[] = {"\\SQ1.XML;1", "\\SQ2.XML;1"};
 
-  for(index = 0; index < p_env->otSize; index++)
+  for(index = 0; index < p_env->primSize; index++)
   {
-    //get object details from the file
+    //get object details from the file, populateOT carves its packets from the engine arena
     p_env->p_primParam[index] = getObjects(fileNames[index]);
-
-    if(p_env->p_primParam[index] != NULL)
-    {
-      //for each buffer create a primitive for each object
-      for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
-      {
-	p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(POLY_F4));
-      }
-    }
   }
 }
 
@@ -89,6 +79,8 @@ void movChase(struct s_environment *p_env)
     p_env->p_primParam[0]->color0.b = 255;
   }
   
+  markPrim(p_env, p_env->p_primParam[0], DIRTY_COLOR);
+  
   //move based upon the other blocks position in the vertical.
   if(p_env->p_primParam[1]->transCoor.vy > p_env->p_primParam[0]->transCoor.vy)
   {
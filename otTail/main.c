@@ -18,7 +18,7 @@ int main()
   char *p_title = "Ordering Table Example\nTail\n";
   struct s_environment environment;
   
-  initEnv(&environment, 10);
+  initEnv(&environment, 10, 0, DOUBLE_BUF);
   
   environment.envMessage.p_message = NULL;
   environment.envMessage.p_data = (int *)&environment.gamePad.one;;
@@ -99,22 +99,22 @@ void movSqrTail(struct s_environment *p_env)
   //take game pad movement and move
   if(p_env->gamePad.one.third.bit.up == 0)
   {
-    movUp(p_env, p_env->otSize);
+    movUp(p_env, p_env->primSize);
   }
   
   if(p_env->gamePad.one.third.bit.left == 0)
   {
-    movLeft(p_env, p_env->otSize);
+    movLeft(p_env, p_env->primSize);
   }
   
   if(p_env->gamePad.one.third.bit.down == 0)
   {
-    movDown(p_env, p_env->otSize);
+    movDown(p_env, p_env->primSize);
   }
 
   if(p_env->gamePad.one.third.bit.right == 0)
   {
-    movRight(p_env, p_env->otSize);
+    movRight(p_env, p_env->primSize);
   }
   
   //if we are not hitting start, move the primitives back to original position
@@ -124,28 +124,28 @@ void movSqrTail(struct s_environment *p_env)
     {
       if(p_env->p_primParam[p_env->primCur]->transCoor.vx > SCREEN_WIDTH / 2 - 25)
       {
-	movLeft(p_env, p_env->otSize);
+	movLeft(p_env, p_env->primSize);
       }
       
       if(p_env->p_primParam[p_env->primCur]->transCoor.vx  < SCREEN_WIDTH / 2 - 25)
       {
-	movRight(p_env, p_env->otSize);
+	movRight(p_env, p_env->primSize);
       }
       
       if(p_env->p_primParam[p_env->primCur]->transCoor.vy < SCREEN_HEIGHT / 2 - 25)
       {
-	movDown(p_env, p_env->otSize);
+	movDown(p_env, p_env->primSize);
       }
       
       if(p_env->p_primParam[p_env->primCur]->transCoor.vy > SCREEN_HEIGHT / 2 - 25)
       {
-	movUp(p_env, p_env->otSize);
+	movUp(p_env, p_env->primSize);
       }
     }
   }
   
   //translate all primitives
-  for(index = p_env->otSize - 2; index >= 0; index--)
+  for(index = p_env->primSize - 2; index >= 0; index--)
   {
     transPrim(p_env->p_primParam[index], p_env);
   }
@@ -157,9 +157,8 @@ void movSqrTail(struct s_environment *p_env)
 void createGameObjects(struct s_environment *p_env)
 {
   int index;
-  int buffIndex;
   
-  for(index = 0; index < p_env->otSize; index++)
+  for(index = 0; index < p_env->primSize; index++)
   {
     //all objects based on same info, all use random colors
     p_env->p_primParam[index] = getObjects("\\SQ1.XML;1");
@@ -178,12 +177,6 @@ void createGameObjects(struct s_environment *p_env)
       p_env->p_primParam[index]->color3.r = rand() % 256;
       p_env->p_primParam[index]->color3.g = rand() % 256;
       p_env->p_primParam[index]->color3.b = rand() % 256;
-      
-      //create a primitive in each buffer for each object
-      for(buffIndex = 0; buffIndex < p_env->bufSize; buffIndex++)
-      {
-	p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(POLY_G4));
-      }
     }
   }
 }
\ No newline at end of file
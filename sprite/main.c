@@ -5,13 +5,20 @@
  * 
  * Move square with D-Pad, press X to change color.
  * 
+ * Build with PSX_DEFINES=-DSCENE_TIMING to also load SCENE.XML and time it against SCENE.BIN.
+ * 
  */
 
 #include <engine.h>
+#include <libapi.h>
 //define world size and number of objects
 #define WORLD_HEIGHT 	480
 #define WORLD_WIDTH  	640
 #define OBJECTS		10
+//lines printed each frame, the header (3 title, message, data), the profile table in profile builds and the stats
+#define TEXT_LINES	(5 + PROF_PRINT_LINES + 4)
+//debug font lines are 8 pixels
+#define TEXT_HEIGHT	(TEXT_LINES * 8)
 
 //create objects
 void createGameObjects(struct s_environment *p_env);
@@ -21,15 +28,31 @@ void movSprite(struct s_environment *p_env);
 void movEnemy(struct s_environment *p_env);
 //rotate squares in world
 void rotSqrs(struct s_environment *p_env);
+//set sprite to its standing frame
+void stand(struct s_environment *p_env, int sprite);
+
+//screen lines (root counter 1) the scene took to load from the compiled binary, and from xml with SCENE_TIMING
+#ifdef SCENE_TIMING
+uint16_t g_xmlLoadLines = 0;
+#endif
+uint16_t g_binLoadLines = 0;
 
 int main() 
 {
   int index;
+  int prevTime = 0;
   
   char *p_title = "Sprite Example\nLoaded From CD\nBITMAP to PSX DATA CONV";
   struct s_environment environment;
 
-  initEnv(&environment, OBJECTS);
+  //one ordering table slot per screen line, sorted by how far down the world the objects stand
+  //two buffers, the vram a third would take at 640,0 holds the sand texture
+  initEnv(&environment, OBJECTS, SCREEN_HEIGHT, DOUBLE_BUF);
+  
+  environment.sortMode = SORT_Y;
+  
+  //scroll with a draw offset, objects that stand still keep their packets while the camera moves
+  environment.cameraMode = CAMERA_OFFSET;
   
   environment.envMessage.p_data = (int *)&environment.gamePad.one;
   environment.envMessage.p_message = NULL;
@@ -40,16 +63,58 @@ int main()
   populateOT(&environment);
   
   populateTextures(&environment);
+  
+  //the sand never moves in the world, draw it once into vram left free by the textures and copy the view
+  //out of it every frame in place of clearing the buffer and drawing the sand
+  addBackground(&environment, 0, 1, 320, 0);
+  
+  //while the camera stands still only redraw around what moved, the text is the header and stats lines
+  environment.useDirtyRect = 1;
+  setRECT(&environment.textRect, 5, 20, SCREEN_WIDTH - 5, TEXT_HEIGHT);
+  
+  reportArena(&environment);
+  
+  //players move every tick, squares turn every 6
+  addJob(&environment, movSprite, 1);
+  addJob(&environment, movEnemy, 1);
+  addJob(&environment, rotSqrs, 6);
 
   for(;;)
   {
     display(&environment);
-    movSprite(&environment);
-    movEnemy(&environment);
-    rotSqrs(&environment);
+    
+    //what the last update drew and what it left out of view
+    FntPrint("\nDRAWN %d CULLED %d %s", environment.primStats.drawn, environment.primStats.culled, (environment.frameMode == FRAME_PIPELINED ? "PIPELINED" : "SYNC"));
+    FntPrint("\nSTATIC %d KEPT %d", getStaticSaved(&environment), environment.primStats.kept);
+    FntPrint("\nROT CACHE HIT %d MISS %d", environment.rotCache.lastHits, environment.rotCache.lastMisses);
+#ifdef SCENE_TIMING
+    FntPrint("\nSCENE LOAD XML %d BIN %d LINES", g_xmlLoadLines, g_binLoadLines);
+#else
+    FntPrint("\nSCENE LOAD BIN %d LINES", g_binLoadLines);
+#endif
+    
+    //start switches display modes, compare the frame times with a profile build
+    if(environment.gamePad.one.third.bit.start == 0)
+    {
+      if(checkRate(&environment, &prevTime, 60))
+      {
+	setFrameMode(&environment, (environment.frameMode == FRAME_PIPELINED ? FRAME_SYNC : FRAME_PIPELINED));
+      }
+    }
+    
+    //select sends the profile ring out over serial
+    if(environment.gamePad.one.third.bit.select == 0)
+    {
+      PROF_DUMP();
+    }
+    
+    //game logic runs on fixed ticks, as many as passed since the last frame
+    PROF_BEGIN(PROF_USER);
+    runJobs(&environment);
+    PROF_END(PROF_USER);
     
     //translate all primitives after updating vectors
-    for(index = 0; index < environment.otSize; index++)
+    for(index = 0; index < environment.primSize; index++)
     {
       transPrim(environment.p_primParam[index], &environment);
     }
@@ -63,60 +128,75 @@ int main()
 //create game objects
 void createGameObjects(struct s_environment *p_env)
 {
+#ifdef SCENE_TIMING
   int index;
-  int buffIndex;
+#endif
+  uint16_t start;
+  
+  SetRCnt(RCntCNT1, 0xFFFF, RCntMdNOINTR);
+  StartRCnt(RCntCNT1);
   
-  //define and get info of each object
-  p_env->p_primParam[0] = getObjects("\\SAND.XML;1");
-  p_env->p_primParam[1] = getObjects("\\SPRITE.XML;1");
-  p_env->p_primParam[2] = getObjects("\\ESPRITE.XML;1");
-  p_env->p_primParam[3] = getObjects("\\SQ1.XML;1");
-  p_env->p_primParam[4] = getObjects("\\SQ2.XML;1");
-  p_env->p_primParam[5] = getObjects("\\SQ3.XML;1");
-  p_env->p_primParam[6] = getObjects("\\SQ4.XML;1");
-  p_env->p_primParam[7] = getObjects("\\SQ5.XML;1");
-  p_env->p_primParam[8] = getObjects("\\SQ6.XML;1");
-  p_env->p_primParam[9] = getObjects("\\SQ7.XML;1");
+#ifdef SCENE_TIMING
+  //the xml scene is only loaded to time it against the binary one compiled from it (make scene), which is kept.
+  //it costs a second seek and read, so normal builds skip it
+  start = GetRCnt(RCntCNT1);
   
-  for(index = 0; index < p_env->otSize; index++)
+  if(getScene(p_env, "\\SCENE.XML;1", 0) < 0)
   {
-    if(p_env->p_primParam[index] != NULL)
-    {
-      //for both buffers create the primitive for the object
-      for(buffIndex = 0; buffIndex < DOUBLE_BUF; buffIndex++)
-      {
-	//based on the type, allocate memory for the primitive in the buffer
-	switch(p_env->p_primParam[index]->type)
-	{
-	  case TYPE_F4:
-	    p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(POLY_F4));
-	    break;
-	  case TYPE_FT4:
-	    p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(POLY_FT4));
-	    break;
-	  case TYPE_SPRITE:
-	    p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(SPRT));
-	    break;
-	  default:
-	    break;
-	}
-      }
-    }
-  } 
+    printf("\nSCENE LOAD FAILED\n");
+  }
+  
+  g_xmlLoadLines = (uint16_t)(GetRCnt(RCntCNT1) - start);
+  
+  for(index = 0; index < p_env->primSize; index++)
+  {
+    freeObjects(p_env, &p_env->p_primParam[index]);
+  }
+#endif
+  
+  //get info of every object from the scene in one read (sand, sprite, esprite, then the squares), packets for them are carved from the engine arena by populateOT.
+  start = GetRCnt(RCntCNT1);
+  
+  if(getSceneBin(p_env, "\\SCENE.BIN;1", 0) < 0)
+  {
+    printf("\nSCENE BIN LOAD FAILED\n");
+  }
+  
+  g_binLoadLines = (uint16_t)(GetRCnt(RCntCNT1) - start);
+  
+  //sand stays behind everything else no matter where it is
+  if(p_env->p_primParam[0] != NULL)
+  {
+    p_env->p_primParam[0]->flags |= PRIM_FLAG_BACKGROUND;
+  }
 }
 
 //animate sprites, allows us to move to the correct place in a sprite table, and have a common timing between frames
 void animate(struct s_environment *p_env, int *op_prevTime, int sprite, int yoffset)
 {
-  if(*op_prevTime == 0 || ((VSync(-1) - *op_prevTime) >= 8))
+  if(checkRate(p_env, op_prevTime, 8))
   {
-    *op_prevTime = VSync(-1);
-    
     p_env->p_primParam[sprite]->p_texture->vertex0.vy = yoffset;
     p_env->p_primParam[sprite]->p_texture->vertex0.vx = (p_env->p_primParam[sprite]->p_texture->vertex0.vx + 64) % 256;
+    
+    markPrim(p_env, p_env->p_primParam[sprite], DIRTY_UV);
   }
 }
 
+//set to standing frame in the sprite table
+void stand(struct s_environment *p_env, int sprite)
+{
+  //already standing, keep the packet as it is
+  if(p_env->p_primParam[sprite]->p_texture->vertex0.vx == 0)
+  {
+    return;
+  }
+  
+  p_env->p_primParam[sprite]->p_texture->vertex0.vx = 0;
+  
+  markPrim(p_env, p_env->p_primParam[sprite], DIRTY_UV);
+}
+
 //move player character
 void movSprite(struct s_environment *p_env)
 { 
@@ -132,12 +212,12 @@ void movSprite(struct s_environment *p_env)
    
   if(p_env->gamePad.one.fourth.bit.ex == 0)
   {
-    if(prevTime == 0 || ((VSync(-1) - prevTime) > 60))
+    if(checkRate(p_env, &prevTime, 60))
     {
       p_env->p_primParam[1]->color0.r = rand() % 256;
       p_env->p_primParam[1]->color0.g = rand() % 256;
       p_env->p_primParam[1]->color0.b = rand() % 256;
-      prevTime = VSync(-1);
+      markPrim(p_env, p_env->p_primParam[1], DIRTY_COLOR);
     }
   }
   //same for all input presses, if the button is pressed
@@ -153,7 +233,7 @@ void movSprite(struct s_environment *p_env)
     else
     {
       //if we are not moving, set to standing frame
-      p_env->p_primParam[1]->p_texture->vertex0.vx = 0;
+      stand(p_env, 1);
     }
     
     //move screen based on player position
@@ -173,7 +253,7 @@ void movSprite(struct s_environment *p_env)
     }
     else
     {
-      p_env->p_primParam[1]->p_texture->vertex0.vx = 0;
+      stand(p_env, 1);
     }
     
     if(((p_env->screenCoor.vx + SCREEN_WIDTH) < WORLD_WIDTH) && (p_env->p_primParam[1]->transCoor.vx >= (SCREEN_WIDTH/2 - 32)))
@@ -191,7 +271,7 @@ void movSprite(struct s_environment *p_env)
     }
     else
     {
-      p_env->p_primParam[1]->p_texture->vertex0.vx = 0;
+      stand(p_env, 1);
     }
     
     if(((p_env->screenCoor.vy + SCREEN_HEIGHT) < WORLD_HEIGHT) && (p_env->p_primParam[1]->transCoor.vy >= (SCREEN_HEIGHT/2 - 32)))
@@ -209,7 +289,7 @@ void movSprite(struct s_environment *p_env)
     }
     else
     {
-      p_env->p_primParam[1]->p_texture->vertex0.vx = 0;
+      stand(p_env, 1);
     }
     
     if((p_env->screenCoor.vx > 0) && (p_env->p_primParam[1]->transCoor.vx <= (WORLD_WIDTH - SCREEN_WIDTH/2 - 32)))
@@ -220,7 +300,7 @@ void movSprite(struct s_environment *p_env)
   //if nothing is pressed, set to standing frame in sprite table
   else
   {
-    p_env->p_primParam[1]->p_texture->vertex0.vx = 0;
+    stand(p_env, 1);
   }
 }
 
@@ -232,7 +312,7 @@ void movEnemy(struct s_environment *p_env)
   //if we're close, stop moving
   if((abs(p_env->p_primParam[1]->transCoor.vy - p_env->p_primParam[0]->transCoor.vy) + 25 < 50) && (abs(p_env->p_primParam[1]->transCoor.vx - p_env->p_primParam[0]->transCoor.vx) + 25 < 50))
   {
-    p_env->p_primParam[2]->p_texture->vertex0.vx = 0;
+    stand(p_env, 2);
     return;
   }
 
@@ -246,7 +326,7 @@ void movEnemy(struct s_environment *p_env)
     }
     else
     {
-      p_env->p_primParam[2]->p_texture->vertex0.vx = 0;
+      stand(p_env, 2);
     }
   }
   //keep moving verticaly towards the player
@@ -259,7 +339,7 @@ void movEnemy(struct s_environment *p_env)
     }
     else
     {
-      p_env->p_primParam[2]->p_texture->vertex0.vx = 0;
+      stand(p_env, 2);
     }
   } 
   //keep moving horizontaly towards the player
@@ -272,7 +352,7 @@ void movEnemy(struct s_environment *p_env)
     }
     else
     {
-      p_env->p_primParam[2]->p_texture->vertex0.vx = 0;
+      stand(p_env, 2);
     }
   }
   //keep moving horizontaly towards the player
@@ -285,12 +365,12 @@ void movEnemy(struct s_environment *p_env)
     }
     else
     {
-      p_env->p_primParam[2]->p_texture->vertex0.vx = 0;
+      stand(p_env, 2);
     }
   }
   else
   {
-    p_env->p_primParam[2]->p_texture->vertex0.vx = 0;
+    stand(p_env, 2);
   }
 }
 
@@ -299,18 +379,12 @@ void movEnemy(struct s_environment *p_env)
 void rotSqrs(struct s_environment *p_env)
 {
   int index;
-  static int prevTime = 0;
   
-  if(prevTime == 0 || ((VSync(-1) - prevTime) > 5))
+  for(index = 0; index < p_env->primSize; index++)
   {
-    for(index = 0; index < p_env->otSize; index++)
+    if(p_env->p_primParam[index]->type == TYPE_F4)
     {
-      if(p_env->p_primParam[index]->type == TYPE_F4)
-      {
-	p_env->p_primParam[index]->rotCoor.vz += 128;
-      }
+      p_env->p_primParam[index]->rotCoor.vz += 128;
     }
-    
-    prevTime = VSync(-1);
   }
 }
\ No newline at end of file
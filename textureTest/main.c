@@ -17,7 +17,7 @@ int main()
   char *p_title = "Texture Example\nLoaded From CD\nBITMAP to PSX DATA CONV";
   struct s_environment environment;
 
-  initEnv(&environment, 1);
+  initEnv(&environment, 1, 0, DOUBLE_BUF);
   
   environment.envMessage.p_data = (int *)&environment.gamePad.one;
   environment.envMessage.p_message = NULL;
@@ -29,10 +29,14 @@ int main()
   
   populateOT(&environment);
 
+  //move the selected primitive every tick
+  addJob(&environment, movPrim, 1);
+
   for(;;)
   {
     display(&environment);
-    movPrim(&environment);
+    runJobs(&environment);
+    updatePrim(&environment);
   }
 
   return 0;
@@ -42,20 +46,19 @@ int main()
 void createGameObjects(struct s_environment *p_env)
 {
   int index;
-  int buffIndex;
+  int hits;
+  int misses;
   
-  //for the number of objects, create them all based on the same xml file
-  for(index = 0; index < p_env->otSize; index++)
+  //for the number of objects, create them all based on the same xml file, read and parsed once, the rest are copies
+  for(index = 0; index < p_env->primSize; index++)
   {
     p_env->p_primParam[index] = getObjects("\\TEXTURE.XML;1");
- 
-    if(p_env->p_primParam[index] != NULL)
-    {
-      //create primtive in both buffers for object.
-      for(buffIndex = 0; buffIndex < DOUBLE_BUF; buffIndex++)
-      {
-	p_env->buffer[buffIndex].p_primitive[index].data = calloc(1, sizeof(POLY_FT4));
-      }
-    }
   } 
+  
+  getObjectStats(&hits, &misses);
+  
+  printf("\nOBJECT CACHE HIT %d MISS %d\n", hits, misses);
+  
+  //no more objects to load, let the template go
+  flushObjects();
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+/*
+ * Tilemap, a 4096 by 4096 world of 16 pixel tiles made in code (nothing read from CD) scrolled with the pad.
+ * 
+ * Only the tiles in view get a packet, the tile count stays the same however big the map is.
+ * The direction pad scrolls, holding cross scrolls faster.
+ * 
+ */
+
+#include <engine.h>
+
+//map size in tiles, and tile size in pixels
+#define MAP_WIDTH  256
+#define MAP_HEIGHT 256
+#define TILE_SIZE  16
+//tiles in the tile set, laid out in one row
+#define TILE_TYPES 4
+
+//tile indexes, row by row
+uint8_t g_tiles[MAP_WIDTH * MAP_HEIGHT];
+//tile set, made in code and loaded to vram at 320,0
+struct s_texture g_tileSet;
+
+//fill the tile set and the map
+void createTilemap(struct s_environment *p_env);
+//scroll the camera with the pad, held in the map
+void movCamera(struct s_environment *p_env);
+
+int main() 
+{
+  char *p_title = "Tilemap\n256x256 Tiles";
+  struct s_environment environment;
+  
+  initEnv(&environment, 1, 0, DOUBLE_BUF);
+  
+  environment.envMessage.p_title = p_title;
+  environment.envMessage.p_message = NULL;
+  environment.envMessage.p_data = (int *)&environment.gamePad.one;
+  
+  //no objects, the arena only holds the ring of tiles for each buffer
+  setArenaSize(&environment, DOUBLE_BUF * (((SCREEN_WIDTH / TILE_SIZE) + 1) * ((SCREEN_HEIGHT / TILE_SIZE) + 1) * sizeof(SPRT_16) + sizeof(DR_TPAGE)));
+  
+  populateOT(&environment);
+  
+  createTilemap(&environment);
+  
+  reportArena(&environment);
+  
+  addJob(&environment, movCamera, 1);
+
+  for(;;)
+  {
+    display(&environment);
+    
+    FntPrint("\nMAP %d TILES\nTILES DRAWN %d\nCAMERA %d %d", MAP_WIDTH * MAP_HEIGHT, environment.primStats.tiles, environment.screenCoor.vx, environment.screenCoor.vy);
+    
+    PROF_BEGIN(PROF_USER);
+    runJobs(&environment);
+    PROF_END(PROF_USER);
+    
+    updatePrim(&environment);
+  }
+
+  return 0;
+}
+
+//tile set of flat colored squares with a dark edge, map of bands and a sprinkle of holes
+void createTilemap(struct s_environment *p_env)
+{
+  int x;
+  int y;
+  int tile;
+  uint16_t *p_pixels;
+  uint16_t const colors[TILE_TYPES] = {0x3DEF, 0x0280, 0x4A52, 0x2D0A};
+  
+  p_pixels = malloc(TILE_TYPES * TILE_SIZE * TILE_SIZE * sizeof(uint16_t));
+  
+  if(p_pixels == NULL)
+  {
+    printf("\nOUT OF MEMORY FOR TILE SET\n");
+    return;
+  }
+  
+  for(y = 0; y < TILE_SIZE; y++)
+  {
+    for(x = 0; x < (TILE_TYPES * TILE_SIZE); x++)
+    {
+      tile = x / TILE_SIZE;
+      
+      //psx 15 bit color, zero is see through so keep the edge off black
+      p_pixels[(y * TILE_TYPES * TILE_SIZE) + x] = (((x % TILE_SIZE) == 0) || (y == 0) ? 0x0421 : colors[tile]);
+    }
+  }
+  
+  g_tileSet.dimensions.w = TILE_TYPES * TILE_SIZE;
+  g_tileSet.dimensions.h = TILE_SIZE;
+  g_tileSet.vramVertex.vx = 320;
+  g_tileSet.vramVertex.vy = 0;
+  g_tileSet.id = LoadTPage((u_long *)p_pixels, 2, 0, g_tileSet.vramVertex.vx, g_tileSet.vramVertex.vy, g_tileSet.dimensions.w, g_tileSet.dimensions.h);
+  
+  //wait for transfer to finish
+  while(DrawSync(1));
+  
+  free(p_pixels);
+  
+  for(y = 0; y < MAP_HEIGHT; y++)
+  {
+    for(x = 0; x < MAP_WIDTH; x++)
+    {
+      g_tiles[(y * MAP_WIDTH) + x] = ((rand() % 16) == 0 ? TILE_EMPTY : ((x / 8) + (y / 8)) % TILE_TYPES);
+    }
+  }
+  
+  setTilemap(p_env, g_tiles, MAP_WIDTH, MAP_HEIGHT, TILE_SIZE, &g_tileSet);
+}
+
+//pad scrolls the camera, kept inside the map
+void movCamera(struct s_environment *p_env)
+{
+  int movAmount;
+  
+  movAmount = (p_env->gamePad.one.fourth.bit.ex == 0 ? 8 : 2);
+  
+  if(p_env->gamePad.one.third.bit.up == 0)
+  {
+    p_env->screenCoor.vy -= movAmount;
+  }
+  
+  if(p_env->gamePad.one.third.bit.down == 0)
+  {
+    p_env->screenCoor.vy += movAmount;
+  }
+  
+  if(p_env->gamePad.one.third.bit.left == 0)
+  {
+    p_env->screenCoor.vx -= movAmount;
+  }
+  
+  if(p_env->gamePad.one.third.bit.right == 0)
+  {
+    p_env->screenCoor.vx += movAmount;
+  }
+  
+  p_env->screenCoor.vx = (p_env->screenCoor.vx < 0 ? 0 : p_env->screenCoor.vx);
+  p_env->screenCoor.vy = (p_env->screenCoor.vy < 0 ? 0 : p_env->screenCoor.vy);
+  p_env->screenCoor.vx = (p_env->screenCoor.vx > (MAP_WIDTH * TILE_SIZE - SCREEN_WIDTH) ? (MAP_WIDTH * TILE_SIZE - SCREEN_WIDTH) : p_env->screenCoor.vx);
+  p_env->screenCoor.vy = (p_env->screenCoor.vy > (MAP_HEIGHT * TILE_SIZE - SCREEN_HEIGHT) ? (MAP_HEIGHT * TILE_SIZE - SCREEN_HEIGHT) : p_env->screenCoor.vy);
+}